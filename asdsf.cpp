@@ -0,0 +1,497 @@
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <math.h>
+#include <stdlib.h>
+
+using namespace std;
+
+#include "translog.h"
+#include "logformat.h"
+#include "translate.h"
+#include "asdsf.h"
+
+// splits below this frequency in every run are ignored (as in MrBayes' minpartfreq)
+static const double minimumSplitFrequency = 0.10;
+// number of most-disagreeing splits reported
+static const int numWorstSplits = 10;
+
+// *** SplitTable *** //
+
+SplitTable::SplitTable (int const& words)
+    : words_(words), size_(0), keys_(1024 * words, 0), counts_(1024, 0), lastTree_(1024, -1)
+{
+}
+
+static uint64_t hashSplit (const uint64_t * split, int const& words) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < words; i++) {
+        hash ^= split[i] + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    }
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// slot holding split, or the empty slot where it would go
+size_t SplitTable::findSlot (const uint64_t * split) const {
+    size_t mask = counts_.size() - 1;
+    size_t slot = hashSplit(split, words_) & mask;
+    while (counts_[slot] > 0 && !equal(split, split + words_, &keys_[slot * words_])) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void SplitTable::grow () {
+    vector <uint64_t> oldKeys;
+    vector <int> oldCounts;
+    vector <int> oldLastTree;
+    oldKeys.swap(keys_);
+    oldCounts.swap(counts_);
+    oldLastTree.swap(lastTree_);
+    size_t newCapacity = oldCounts.size() * 2;
+    keys_.assign(newCapacity * words_, 0);
+    counts_.assign(newCapacity, 0);
+    lastTree_.assign(newCapacity, -1);
+    for (size_t i = 0; i < oldCounts.size(); i++) {
+        if (oldCounts[i] > 0) {
+            size_t slot = findSlot(&oldKeys[i * words_]);
+            copy(&oldKeys[i * words_], &oldKeys[i * words_] + words_, &keys_[slot * words_]);
+            counts_[slot] = oldCounts[i];
+            lastTree_[slot] = oldLastTree[i];
+        }
+    }
+}
+
+void SplitTable::add (const uint64_t * split, int const& tree) {
+    if (2 * (size_ + 1) > counts_.size()) {
+        grow();
+    }
+    size_t slot = findSlot(split);
+    if (counts_[slot] == 0) {
+        copy(split, split + words_, &keys_[slot * words_]);
+        size_++;
+    } else if (lastTree_[slot] == tree) {
+        return;
+    }
+    counts_[slot]++;
+    lastTree_[slot] = tree;
+}
+
+int SplitTable::count (const uint64_t * split) const {
+    return counts_[findSlot(split)];
+}
+
+// *** Taxa *** //
+
+// Leaf labels (as they appear in the trees) mapped to bit positions. Labels that are
+// all translate-table numbers get a dense lookup; anything else goes through the map.
+struct TaxonIndex {
+    map <string, int> byLabel;
+    vector <int> byNumber;
+    vector <string> labels;
+    bool numeric;
+    int words;
+};
+
+static bool isLabelEnd (char c) {
+    return c == ':' || c == ',' || c == '(' || c == ')' || c == ';' || c == '[' || isSpaceChar(c);
+}
+
+// position of the opening parenthesis of the tree, skipping [comments]
+static size_t findTreeStart (string const& line) {
+    size_t pos = 0;
+    while (pos < line.size() && line[pos] != '(') {
+        if (line[pos] == '[') {
+            pos = line.find(']', pos);
+            if (pos == string::npos) {
+                return line.size();
+            }
+        }
+        pos++;
+    }
+    return pos;
+}
+
+static size_t readLeafLabel (string const& line, size_t pos, string & label) {
+    size_t start = pos;
+    if (line[pos] == '\'') {
+        pos = line.find('\'', pos + 1);
+        pos = (pos == string::npos) ? line.size() : pos + 1;
+    } else {
+        while (pos < line.size() && !isLabelEnd(line[pos])) {
+            pos++;
+        }
+    }
+    label.assign(line, start, pos - start);
+    return pos;
+}
+
+// skip internal node label / branch length, up to the next structural character
+static size_t skipNodeSuffix (string const& line, size_t pos) {
+    while (pos < line.size()) {
+        char c = line[pos];
+        if (c == ',' || c == '(' || c == ')' || c == ';' || c == '[') {
+            break;
+        }
+        pos++;
+    }
+    return pos;
+}
+
+static bool allDigits (string const& label) {
+    if (label.empty() || label.size() > 9) {
+        return false;
+    }
+    for (size_t i = 0; i < label.size(); i++) {
+        if (label[i] < '0' || label[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void buildTaxonIndex (string const& treeLine, TaxonIndex & taxa) {
+    vector <string> labels;
+    string label;
+    size_t pos = findTreeStart(treeLine);
+    while (pos < treeLine.size() && treeLine[pos] != ';') {
+        char c = treeLine[pos];
+        if (c == '[') {
+        // annotations (e.g. BEAST's [&rate=...]) follow a node; what comes after is its suffix
+            pos = treeLine.find(']', pos);
+            pos = (pos == string::npos) ? treeLine.size() : skipNodeSuffix(treeLine, pos + 1);
+        } else if (c == '(' || c == ',' || isSpaceChar(c)) {
+            pos++;
+        } else if (c == ')') {
+            pos = skipNodeSuffix(treeLine, pos + 1);
+        } else {
+            pos = readLeafLabel(treeLine, pos, label);
+            if (!label.empty()) {
+                labels.push_back(label);
+            }
+            pos = skipNodeSuffix(treeLine, pos);
+        }
+    }
+    sort(labels.begin(), labels.end());
+    labels.erase(unique(labels.begin(), labels.end()), labels.end());
+
+    taxa.labels = labels;
+    taxa.numeric = true;
+    for (size_t i = 0; i < labels.size(); i++) {
+        taxa.byLabel[labels[i]] = i;
+        if (!allDigits(labels[i])) {
+            taxa.numeric = false;
+        }
+    }
+    if (taxa.numeric) {
+        for (size_t i = 0; i < labels.size(); i++) {
+            int number = atoi(labels[i].c_str());
+            if (number >= (int)taxa.byNumber.size()) {
+                taxa.byNumber.resize(number + 1, -1);
+            }
+            taxa.byNumber[number] = i;
+        }
+    }
+    taxa.words = (labels.size() + 63) / 64;
+}
+
+static int lookupTaxon (TaxonIndex const& taxa, string const& label) {
+    if (taxa.numeric) {
+        if (!allDigits(label)) {
+            return -1;
+        }
+        int number = atoi(label.c_str());
+        return number < (int)taxa.byNumber.size() ? taxa.byNumber[number] : -1;
+    }
+    map <string, int>::const_iterator found = taxa.byLabel.find(label);
+    return found == taxa.byLabel.end() ? -1 : found->second;
+}
+
+// *** Per-run split collection *** //
+
+struct RunSplits {
+    RunSplits (int const& words) : table(words), trees(0) {}
+    SplitTable table;
+    int trees;
+    string error;
+};
+
+// Adds the non-trivial splits of one tree, each normalised so that the first taxon is
+// on the unset side (i.e. unrooted bipartitions). Returns false if the tree is malformed.
+static bool addTreeSplits (string const& line, TaxonIndex const& taxa, int const& treeNumber,
+    vector <uint64_t> & stack, SplitTable & table)
+{
+    int words = taxa.words;
+    int numTaxa = taxa.labels.size();
+    uint64_t lastMask = (numTaxa % 64 == 0) ? ~0ULL : ((1ULL << (numTaxa % 64)) - 1);
+    vector <uint64_t> split(words);
+    string label;
+    int depth = 0;
+    size_t pos = findTreeStart(line);
+
+    while (pos < line.size()) {
+        char c = line[pos];
+        if (c == '[') {
+            pos = line.find(']', pos);
+            pos = (pos == string::npos) ? line.size() : skipNodeSuffix(line, pos + 1);
+        } else if (c == '(') {
+            depth++;
+            if ((int)stack.size() < (depth + 1) * words) {
+                stack.resize((depth + 1) * words);
+            }
+            fill(&stack[depth * words], &stack[depth * words] + words, 0);
+            pos++;
+        } else if (c == ')') {
+            if (depth < 1) {
+                return false;
+            }
+            uint64_t * clade = &stack[depth * words];
+            depth--;
+            if (depth > 0) {
+                int size = 0;
+                for (int i = 0; i < words; i++) {
+                    stack[depth * words + i] |= clade[i];
+                    size += __builtin_popcountll(clade[i]);
+                }
+                if (size >= 2 && size <= numTaxa - 2) {
+                    bool complement = (clade[0] & 1ULL) != 0;
+                    for (int i = 0; i < words; i++) {
+                        split[i] = complement ? ~clade[i] : clade[i];
+                    }
+                    split[words - 1] &= lastMask;
+                    table.add(&split[0], treeNumber);
+                }
+            }
+            pos = skipNodeSuffix(line, pos + 1);
+        } else if (c == ',' || isSpaceChar(c)) {
+            pos++;
+        } else if (c == ';') {
+            break;
+        } else {
+            pos = readLeafLabel(line, pos, label);
+            int taxon = label.empty() ? -1 : lookupTaxon(taxa, label);
+            if (taxon < 0 || depth < 1) {
+                return false;
+            }
+            stack[depth * words + taxon / 64] |= 1ULL << (taxon % 64);
+            pos = skipNodeSuffix(line, pos);
+        }
+    }
+    return depth == 0;
+}
+
+template <typename Dialect>
+static void collectRunSplitsAs (string const& currentFile, TaxonIndex const& taxa, int const& thinning,
+    int const& burnin, RunSplits & run)
+{
+    ifstream treeInput(currentFile.c_str());
+    string line;
+    vector <uint64_t> stack;
+    int treeCounter = 0;
+    while (getline(treeInput, line)) {
+        if (classifyTreeLine<Dialect>(line) != LINE_SAMPLE) {
+            continue;
+        }
+        if (retainSample(treeCounter, burnin, thinning)) {
+            if (!addTreeSplits(line, taxa, run.trees, stack, run.table)) {
+                run.error = "unable to parse tree " + convertIntToString(treeCounter + 1)
+                    + " of file '" + currentFile + "' (unknown taxon or unbalanced parentheses)";
+                return;
+            }
+            run.trees++;
+        }
+        treeCounter++;
+    }
+}
+
+static void collectRunSplits (LogFormat format, string currentFile, TaxonIndex const* taxa,
+    int thinning, int burnin, RunSplits * run)
+{
+    withDialect(format, [&](auto dialect) {
+        collectRunSplitsAs<decltype(dialect)>(currentFile, *taxa, thinning, burnin, *run);
+    });
+}
+
+// Reads the header of the first run up to its first tree: the translate table (for
+// reporting names) and the leaf labels that define the taxon bit positions
+template <typename Dialect>
+static bool readTaxaAs (string const& currentFile, TaxonIndex & taxa, TranslateTable & translation) {
+    ifstream treeInput(currentFile.c_str());
+    string line;
+    while (getline(treeInput, line)) {
+        LineKind kind = classifyTreeLine<Dialect>(line);
+        if (kind == LINE_SAMPLE) {
+            buildTaxonIndex(line, taxa);
+            return true;
+        } else if (kind == LINE_OTHER) {
+            translation.parseLine(line);
+        }
+    }
+    return false;
+}
+
+static bool readTaxa (LogFormat const& format, string const& currentFile, TaxonIndex & taxa,
+    TranslateTable & translation)
+{
+    return withDialect(format, [&](auto dialect) {
+        return readTaxaAs<decltype(dialect)>(currentFile, taxa, translation);
+    });
+}
+
+// the smaller side of a split, by taxon name where a translation is available
+static string describeSplit (const uint64_t * split, TaxonIndex const& taxa,
+    TranslateTable const& translation)
+{
+    int numTaxa = taxa.labels.size();
+    int size = 0;
+    for (int i = 0; i < numTaxa; i++) {
+        if (split[i / 64] & (1ULL << (i % 64))) {
+            size++;
+        }
+    }
+    bool wantSet = (2 * size <= numTaxa);
+    string description = "{";
+    int listed = 0;
+    for (int i = 0; i < numTaxa; i++) {
+        bool isSet = (split[i / 64] & (1ULL << (i % 64))) != 0;
+        if (isSet != wantSet) {
+            continue;
+        }
+        if (listed == 8) {
+            description += ", ...";
+            break;
+        }
+        string const& label = taxa.labels[i];
+        int number = allDigits(label) ? atoi(label.c_str()) : -1;
+        description += (listed > 0 ? ", " : "");
+        description += translation.hasName(number) ? translation.name(number) : label;
+        listed++;
+    }
+    description += "} (" + convertIntToString(wantSet ? size : numTaxa - size) + " taxa)";
+    return description;
+}
+
+struct SplitDeviation {
+    double sd;
+    size_t slot;
+    bool operator< (SplitDeviation const& other) const { return sd > other.sd; }
+};
+
+void computeASDSF (string const& fileName, int const& nruns, string & suffix,
+    int const& thinning, int const& burnin)
+{
+    if (nruns < 2) {
+        cerr << "Error: the ASDSF requires at least 2 runs ('-r'). Exiting." << endl;
+        exit(1);
+    }
+    if (suffix.empty()) {
+        suffix = resolveDefaultSuffix(fileName, nruns, "tree");
+    }
+
+    vector <string> runFiles;
+    vector <LogFormat> formats;
+    for (int i = 0; i < nruns; i++) {
+        runFiles.push_back(runFileName(fileName, nruns, i, suffix));
+        checkValidInputFile(runFiles[i]);
+        formats.push_back(detectLogFormat(runFiles[i], "tree"));
+    }
+
+    TaxonIndex taxa;
+    TranslateTable translation;
+    if (!readTaxa(formats[0], runFiles[0], taxa, translation) || taxa.labels.size() < 4) {
+        cerr << "Error: no trees (with at least 4 taxa) found in file '" << runFiles[0] << "'. Exiting." << endl;
+        exit(1);
+    }
+
+    cout << "COMPUTING SPLIT FREQUENCIES FOR " << nruns << " RUNS (" << taxa.labels.size()
+        << " taxa)..." << endl << endl;
+
+    vector <RunSplits *> runs;
+    vector <thread> workers;
+    for (int i = 0; i < nruns; i++) {
+        runs.push_back(new RunSplits(taxa.words));
+        workers.push_back(thread(collectRunSplits, formats[i], runFiles[i], &taxa, thinning, burnin, runs[i]));
+    }
+    for (int i = 0; i < nruns; i++) {
+        workers[i].join();
+    }
+    for (int i = 0; i < nruns; i++) {
+        if (!runs[i]->error.empty()) {
+            cerr << "Error: " << runs[i]->error << ". Exiting." << endl;
+            exit(1);
+        }
+        if (runs[i]->trees == 0) {
+            cerr << "Error: no post-burnin trees in file '" << runFiles[i] << "'. Exiting." << endl;
+            exit(1);
+        }
+        cout << "Read " << runs[i]->trees << " post-burnin trees (" << runs[i]->table.size()
+            << " distinct splits) from file '" << runFiles[i] << "'." << endl;
+    }
+
+// every split seen in any run
+    SplitTable allSplits(taxa.words);
+    for (int i = 0; i < nruns; i++) {
+        SplitTable const& table = runs[i]->table;
+        for (size_t slot = 0; slot < table.capacity(); slot++) {
+            if (table.occupied(slot)) {
+                allSplits.add(table.key(slot), 0);
+            }
+        }
+    }
+
+    vector <SplitDeviation> deviations;
+    double sumSD = 0.0;
+    vector <double> frequencies(nruns);
+    for (size_t slot = 0; slot < allSplits.capacity(); slot++) {
+        if (!allSplits.occupied(slot)) {
+            continue;
+        }
+        double mean = 0.0;
+        double maxFrequency = 0.0;
+        for (int i = 0; i < nruns; i++) {
+            frequencies[i] = (double)runs[i]->table.count(allSplits.key(slot)) / runs[i]->trees;
+            mean += frequencies[i];
+            maxFrequency = max(maxFrequency, frequencies[i]);
+        }
+        if (maxFrequency < minimumSplitFrequency) {
+            continue;
+        }
+        mean /= nruns;
+        double sumSquares = 0.0;
+        for (int i = 0; i < nruns; i++) {
+            sumSquares += (frequencies[i] - mean) * (frequencies[i] - mean);
+        }
+        SplitDeviation deviation = {sqrt(sumSquares / (nruns - 1)), slot};
+        deviations.push_back(deviation);
+        sumSD += deviation.sd;
+    }
+
+    double asdsf = deviations.empty() ? 0.0 : sumSD / deviations.size();
+    cout << endl << "Average standard deviation of split frequencies (splits with frequency >= "
+        << minimumSplitFrequency << " in at least one run; " << deviations.size() << " splits): "
+        << asdsf << endl;
+
+    int numReported = min((int)deviations.size(), numWorstSplits);
+    partial_sort(deviations.begin(), deviations.begin() + numReported, deviations.end());
+    if (numReported > 0) {
+        cout << endl << "Splits with the largest standard deviation of frequencies:" << endl;
+    }
+    for (int j = 0; j < numReported; j++) {
+        const uint64_t * split = allSplits.key(deviations[j].slot);
+        cout << "  sd = " << deviations[j].sd << "; frequencies:";
+        for (int i = 0; i < nruns; i++) {
+            cout << " " << (double)runs[i]->table.count(split) / runs[i]->trees;
+        }
+        cout << endl << "    " << describeSplit(split, taxa, translation) << endl;
+    }
+
+    for (int i = 0; i < nruns; i++) {
+        delete runs[i];
+    }
+}
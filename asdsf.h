@@ -0,0 +1,38 @@
+#ifndef _ASDSF_H_
+#define _ASDSF_H_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+using namespace std;
+
+// Hash table of tree bipartitions (splits), each a fixed-width bitset over the taxa.
+// Open addressing with keys held contiguously, so tables for hundreds of taxa and
+// hundreds of thousands of trees stay compact.
+class SplitTable {
+public:
+    explicit SplitTable (int const& words);
+    void add (const uint64_t * split, int const& tree);
+    int count (const uint64_t * split) const;
+    size_t capacity () const { return counts_.size(); }
+    bool occupied (size_t const& slot) const { return counts_[slot] > 0; }
+    const uint64_t * key (size_t const& slot) const { return &keys_[slot * words_]; }
+    int countAt (size_t const& slot) const { return counts_[slot]; }
+    size_t size () const { return size_; }
+private:
+    size_t findSlot (const uint64_t * split) const;
+    void grow ();
+    int words_;
+    size_t size_;
+    vector <uint64_t> keys_;
+    vector <int> counts_;
+    vector <int> lastTree_; // a split is counted at most once per tree
+};
+
+// Average standard deviation of split frequencies across replicate tree runs.
+// Each run is read on its own thread.
+void computeASDSF (string const& fileName, int const& nruns, string & suffix,
+    int const& thinning, int const& burnin);
+
+#endif /* _ASDSF_H_ */
@@ -0,0 +1,99 @@
+
+#include <iostream>
+#include <fstream>
+
+using namespace std;
+
+#include "logformat.h"
+#include "translog.h"
+
+// how much of the start of a file is inspected to determine its format
+static const size_t formatProbeBytes = 8192;
+
+static bool probeContains (string const& probe, const char * text) {
+    return probe.find(text) != string::npos;
+}
+
+// Looks at the first few KB of a file and guesses which program wrote it.
+// Falls back to MrBayes (the original behaviour) when nothing distinctive is found.
+LogFormat detectLogFormat (string const& fileName, string const& type) {
+    ifstream probeInput(fileName.c_str(), ios::binary);
+    string probe(formatProbeBytes, '\0');
+    probeInput.read(&probe[0], formatProbeBytes);
+    probe.resize(probeInput.gcount());
+    return detectLogFormatFromProbe(probe, type);
+}
+
+LogFormat detectLogFormatFromProbe (string const& probe, string const& type) {
+// not 'tree gen.': MrBayes 3.2 names its trees that way too (ExaBayes trees are read the same)
+    if (probeContains(probe, "ExaBayes")) {
+        return FORMAT_EXABAYES;
+    }
+    if (probeContains(probe, "BEAST") || probeContains(probe, "[&lnP=") || probeContains(probe, "tree STATE_")) {
+        return FORMAT_BEAST;
+    }
+
+    // otherwise go by the first token of the first non-comment line
+    size_t lineStart = 0;
+    while (lineStart < probe.size()) {
+        size_t lineEnd = probe.find('\n', lineStart);
+        if (lineEnd == string::npos) {
+            lineEnd = probe.size();
+        }
+        string line = probe.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t start = skipWhiteSpace(line, 0);
+        if (start == line.size() || line[0] == '[' || line[0] == '#') {
+            continue;
+        }
+        size_t end = skipToken(line, start);
+        if (RevBayesDialect::isHeaderToken(line, start, end)) {
+            return FORMAT_REVBAYES;
+        }
+        if (type == "parameter" && BeastDialect::isHeaderToken(line, start, end)) {
+            return FORMAT_BEAST;
+        }
+        if (type == "parameter" && tokenMatches(line, start, end, "Gen")) {
+        // ExaBayes writes the prior before the likelihood
+            size_t second = skipWhiteSpace(line, end);
+            if (tokenMatches(line, second, skipToken(line, second), "LnPr")) {
+                return FORMAT_EXABAYES;
+            }
+        }
+        break;
+    }
+    return FORMAT_MRBAYES;
+}
+
+string logFormatName (LogFormat const& format) {
+    switch (format) {
+        case FORMAT_BEAST:    return "BEAST";
+        case FORMAT_REVBAYES: return "RevBayes";
+        case FORMAT_EXABAYES: return "ExaBayes";
+        default:              return "MrBayes";
+    }
+}
+
+bool nexusTreeFormat (LogFormat const& format) {
+    return format != FORMAT_REVBAYES;
+}
+
+// When no suffix is given for replicated runs, use the first conventional suffix
+// (MrBayes '.t'/'.p', then BEAST/RevBayes '.trees'/'.log') for which 'prefix.run1.suffix' exists
+string resolveDefaultSuffix (string const& fileName, int const& nruns, string const& type) {
+    const char * treeSuffixes[] = {"t", "trees"};
+    const char * parameterSuffixes[] = {"p", "log"};
+    const char ** candidates = (type == "tree") ? treeSuffixes : parameterSuffixes;
+
+    if (nruns > 1) {
+        for (int i = 0; i < 2; i++) {
+            string candidate = fileName + ".run1." + candidates[i];
+            ifstream testInput(candidate.c_str());
+            if (testInput.good()) {
+                return candidates[i];
+            }
+        }
+    }
+    return candidates[0];
+}
@@ -0,0 +1,190 @@
+#ifndef _LOGFORMAT_H_
+#define _LOGFORMAT_H_
+
+#include <string>
+#include <ctype.h>
+
+using namespace std;
+
+// Program (dialect) that wrote a tree or parameter log
+enum LogFormat {
+    FORMAT_MRBAYES,
+    FORMAT_BEAST,
+    FORMAT_REVBAYES,
+    FORMAT_EXABAYES
+};
+
+// What a single line of a log holds
+enum LineKind {
+    LINE_BLANK,   // empty or whitespace only
+    LINE_COMMENT, // comment (first character is a dialect comment character)
+    LINE_HEADER,  // parameter (or tabular tree) column header
+    LINE_SAMPLE,  // a sample: tree or row of parameter values
+    LINE_OTHER    // anything else e.g. NEXUS commands, translation table
+};
+
+LogFormat detectLogFormat (string const& fileName, string const& type);
+LogFormat detectLogFormatFromProbe (string const& probe, string const& type);
+bool nexusTreeFormat (LogFormat const& format);
+string logFormatName (LogFormat const& format);
+string resolveDefaultSuffix (string const& fileName, int const& nruns, string const& type);
+
+// *** Byte-level scanning helpers *** //
+
+inline bool isSpaceChar (char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline size_t skipWhiteSpace (string const& line, size_t pos) {
+    size_t len = line.size();
+    while (pos < len && isSpaceChar(line[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+inline size_t skipToken (string const& line, size_t pos) {
+    size_t len = line.size();
+    while (pos < len && !isSpaceChar(line[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+// case-insensitive comparison of line[start, end) against a word
+inline bool tokenMatches (string const& line, size_t start, size_t end, const char * word) {
+    size_t i = 0;
+    for (; word[i] != '\0'; i++) {
+        if (start + i >= end || toupper((unsigned char)line[start + i]) != toupper((unsigned char)word[i])) {
+            return false;
+        }
+    }
+    return start + i == end;
+}
+
+// Appends every whitespace-delimited token from pos onwards, each preceded by a tab.
+// Equivalent to the (much slower) removeStringElement on the remainder of the line.
+inline void appendTabJoinedTokens (string & out, string const& line, size_t pos) {
+    size_t len = line.size();
+    pos = skipWhiteSpace(line, pos);
+    while (pos < len) {
+        size_t end = skipToken(line, pos);
+        out += '\t';
+        out.append(line, pos, end - pos);
+        pos = skipWhiteSpace(line, end);
+    }
+}
+
+// *** Dialects *** //
+// Each dialect supplies its comment characters, header keywords and whether trees
+// are written as NEXUS 'tree label = ...' commands or as a tabular (one row per sample) log.
+// Everything is resolved at compile time, so the per-line loops below carry no format checks.
+
+struct MrBayesDialect {
+    static constexpr bool nexusTrees = true;
+    static bool isCommentChar (char c) { return c == '[' || c == '#'; }
+    static bool isHeaderToken (string const& line, size_t start, size_t end) {
+        return tokenMatches(line, start, end, "Gen");
+    }
+};
+
+// BEAST 1.x/2.x: '# BEAST ...' comments; 'state' (1.x) or 'Sample' (2.x) header;
+// tree lines of the form 'tree STATE_n [&lnP=...,posterior=...] = [&R] (...)'
+struct BeastDialect {
+    static constexpr bool nexusTrees = true;
+    static bool isCommentChar (char c) { return c == '#' || c == '['; }
+    static bool isHeaderToken (string const& line, size_t start, size_t end) {
+        return tokenMatches(line, start, end, "state") || tokenMatches(line, start, end, "Sample");
+    }
+};
+
+// RevBayes: both parameter and tree logs are tab-delimited tables with an 'Iteration' column;
+// trees are the final (newick) column
+struct RevBayesDialect {
+    static constexpr bool nexusTrees = false;
+    static bool isCommentChar (char c) { return c == '#'; }
+    static bool isHeaderToken (string const& line, size_t start, size_t end) {
+        return tokenMatches(line, start, end, "Iteration");
+    }
+};
+
+// ExaBayes: read as MrBayes ('tree gen.n = [&U] (...)' tree lines, 'Gen' header); only
+// detection and the reported name differ
+using ExaBayesDialect = MrBayesDialect;
+
+// Calls f with the dialect of format, e.g.
+//   withDialect(format, [&](auto dialect) { return countAs<decltype(dialect)>(input); })
+// so each per-format template is dispatched in one place
+template <typename F>
+inline auto withDialect (LogFormat const& format, F f) -> decltype(f(MrBayesDialect())) {
+    switch (format) {
+        case FORMAT_BEAST:    return f(BeastDialect());
+        case FORMAT_REVBAYES: return f(RevBayesDialect());
+        case FORMAT_EXABAYES: return f(ExaBayesDialect());
+        default:              return f(MrBayesDialect());
+    }
+}
+
+// Lines are classified by their first token, so readers that skip past lines (which may be
+// MBs long) read only this much of each up front
+const size_t lineHeadBytes = 256;
+
+template <typename Dialect>
+inline LineKind classifyTreeLine (string const& line) {
+    if (line.empty()) {
+        return LINE_BLANK;
+    }
+    if (Dialect::isCommentChar(line[0])) {
+        return LINE_COMMENT;
+    }
+    size_t start = skipWhiteSpace(line, 0);
+    if (start == line.size()) {
+        return LINE_BLANK;
+    }
+    size_t end = skipToken(line, start);
+    if (Dialect::nexusTrees) {
+        return tokenMatches(line, start, end, "tree") ? LINE_SAMPLE : LINE_OTHER;
+    }
+    return Dialect::isHeaderToken(line, start, end) ? LINE_HEADER : LINE_SAMPLE;
+}
+
+template <typename Dialect>
+inline LineKind classifyParameterLine (string const& line) {
+    if (line.empty()) {
+        return LINE_BLANK;
+    }
+    if (Dialect::isCommentChar(line[0])) {
+        return LINE_COMMENT;
+    }
+    size_t start = skipWhiteSpace(line, 0);
+    if (start == line.size()) {
+        return LINE_BLANK;
+    }
+    return Dialect::isHeaderToken(line, start, skipToken(line, start)) ? LINE_HEADER : LINE_SAMPLE;
+}
+
+template <typename Dialect>
+inline LineKind classifyLineAs (string const& line, bool const& trees) {
+    return trees ? classifyTreeLine<Dialect>(line) : classifyParameterLine<Dialect>(line);
+}
+
+// Rewrites a sample line with a new sample number. NEXUS: 'tree STATE_n' followed by the
+// remaining tokens (annotations and the tree itself); tabular: the number replaces the first column.
+template <typename Dialect>
+inline void relabelTreeLine (string & out, string const& line, int const& sampleNumber) {
+    size_t pos = skipToken(line, skipWhiteSpace(line, 0)); // 'tree' or iteration
+    if (Dialect::nexusTrees) {
+        pos = skipToken(line, skipWhiteSpace(line, pos));  // original label e.g. 'rep.1000'
+        out += "tree STATE_";
+    }
+    out += to_string(sampleNumber);
+    appendTabJoinedTokens(out, line, pos);
+}
+
+inline void relabelParameterLine (string & out, string const& line, int const& sampleNumber) {
+    size_t pos = skipToken(line, skipWhiteSpace(line, 0));
+    out += to_string(sampleNumber);
+    appendTabJoinedTokens(out, line, pos);
+}
+
+#endif /* _LOGFORMAT_H_ */
@@ -0,0 +1,639 @@
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+#include "translog.h"
+#include "logformat.h"
+#include "logstream.h"
+#include "logserver.h"
+
+static const size_t scanBlockBytes = 1 << 20;
+static const size_t tailCheckBytes = 64;
+static const size_t maxRequestBytes = 1 << 20;
+
+static char serverSocketPath[sizeof(((sockaddr_un *)0)->sun_path)];
+
+// *** Socket I/O *** //
+
+static bool writeAll (int const& fd, const char * data, size_t size) {
+    while (size > 0) {
+        ssize_t numWritten = write(fd, data, size);
+        if (numWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += numWritten;
+        size -= numWritten;
+    }
+    return true;
+}
+
+// Buffered output to a connected socket, so replies can be written with the usual ostream calls
+class SocketOutputBuffer : public streambuf {
+public:
+    explicit SocketOutputBuffer (int const& fd) : fd_(fd), buffer_(1 << 16) {
+        setp(&buffer_[0], &buffer_[0] + buffer_.size());
+    }
+    ~SocketOutputBuffer () { sync(); }
+protected:
+    int_type overflow (int_type c) {
+        if (sync() != 0) {
+            return traits_type::eof();
+        }
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+    int sync () {
+        bool written = writeAll(fd_, pbase(), pptr() - pbase());
+        setp(&buffer_[0], &buffer_[0] + buffer_.size());
+        return written ? 0 : -1;
+    }
+private:
+    int fd_;
+    vector <char> buffer_;
+};
+
+static bool readRequestLine (int const& fd, string & line) {
+    char c;
+    line.clear();
+    while (line.size() < maxRequestBytes) {
+        ssize_t numRead = read(fd, &c, 1);
+        if (numRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (numRead <= 0) {
+            return false;
+        }
+        if (c == '\n') {
+            return true;
+        }
+        line += c;
+    }
+    return false;
+}
+
+static vector <string> splitFields (string const& line) {
+    vector <string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end == string::npos ? string::npos : end - start));
+        if (end == string::npos) {
+            return fields;
+        }
+        start = end + 1;
+    }
+}
+
+static bool readRange (int const& fd, long long const& start, long long const& end, string & bytes) {
+    bytes.resize(end - start);
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t numRead = pread(fd, &bytes[done], bytes.size() - done, start + done);
+        if (numRead <= 0) {
+            bytes.resize(done);
+            return false;
+        }
+        done += numRead;
+    }
+    return true;
+}
+
+// *** Indexing *** //
+
+template <typename Dialect>
+static bool addIndexedLine (int const& fd, LogFileIndex & index, bool const& trees, string const& head,
+    long long const& start, long long const& end)
+{
+    LineKind kind = classifyLineAs<Dialect>(head, trees);
+    if (kind == LINE_SAMPLE) {
+        if (index.dataStart < 0) {
+            index.dataStart = start;
+        }
+        index.starts.push_back(start);
+        index.ends.push_back(end);
+        return true;
+    }
+    if (!trees && kind == LINE_HEADER && index.columns == 0) {
+        string line;
+        readRange(fd, start, end, line);
+        index.columns = tokenize(line).size();
+    }
+    return false;
+}
+
+// Indexes the lines from index.scannedEnd to the end of the file. Only the head of each
+// line is looked at; the rest is skipped by searching for the newline.
+template <typename Dialect>
+static void scanLogAs (int const& fd, LogFileIndex & index, bool const& trees) {
+    vector <char> block(scanBlockBytes);
+    string head;
+    bool headDone = false;
+    long long lineStart = index.scannedEnd;
+    long long pos = index.scannedEnd;
+    ssize_t numRead;
+
+    while ((numRead = pread(fd, &block[0], block.size(), pos)) > 0) {
+        const char * p = &block[0];
+        const char * end = p + numRead;
+        while (p < end) {
+            const char * newline = (const char *)memchr(p, '\n', end - p);
+            const char * stop = newline ? newline : end;
+            while (!headDone && p < stop) {
+                size_t take = (size_t)(stop - p) < lineHeadBytes ? (size_t)(stop - p) : lineHeadBytes;
+                head.append(p, take);
+                p += take;
+                headDone = head.size() >= lineHeadBytes
+                    && skipToken(head, skipWhiteSpace(head, 0)) < head.size();
+            }
+            if (newline == NULL) {
+                break;
+            }
+            long long lineEnd = pos + (newline - &block[0]);
+            addIndexedLine<Dialect>(fd, index, trees, head, lineStart, lineEnd);
+            lineStart = lineEnd + 1;
+            head.clear();
+            headDone = false;
+            p = newline + 1;
+        }
+        pos += numRead;
+    }
+    index.scannedEnd = lineStart;
+    index.partialSamples = 0;
+    if (lineStart < pos && addIndexedLine<Dialect>(fd, index, trees, head, lineStart, pos)) {
+        index.partialSamples = 1;
+    }
+    index.size = pos;
+    long long tailStart = (index.scannedEnd > (long long)tailCheckBytes) ? index.scannedEnd - tailCheckBytes : 0;
+    readRange(fd, tailStart, index.scannedEnd, index.scannedTail);
+}
+
+static void scanLog (int const& fd, LogFileIndex & index, bool const& trees) {
+    withDialect(index.format, [&](auto dialect) {
+        scanLogAs<decltype(dialect)>(fd, index, trees);
+    });
+}
+
+static long long modificationTime (struct stat const& info) {
+#ifdef __APPLE__
+    return info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+    return info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+}
+
+// Brings the index up to date with the file; returns how (for the server log)
+static string refreshIndex (string const& fileName, string const& type, LogFileIndex & index,
+    bool const& known, string & error)
+{
+    struct stat info;
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        error = "unable to open file '" + fileName + "'";
+        return "";
+    }
+    bool sameFile = known && index.device == (uint64_t)info.st_dev && index.inode == (uint64_t)info.st_ino;
+// timestamps can be coarser than successive writes, so the last indexed bytes are compared too
+    string tail;
+    long long tailStart = (index.scannedEnd > (long long)tailCheckBytes) ? index.scannedEnd - tailCheckBytes : 0;
+    bool tailUnchanged = sameFile && readRange(fd, tailStart, index.scannedEnd, tail) && tail == index.scannedTail;
+    if (tailUnchanged && index.size == (long long)info.st_size && index.modified == modificationTime(info)) {
+        close(fd);
+        return "cached";
+    }
+    string how = "indexed";
+    if (tailUnchanged && (long long)info.st_size > index.size) {
+    // appended to: drop the old unterminated line and carry on from the last complete one
+        index.starts.resize(index.starts.size() - index.partialSamples);
+        index.ends.resize(index.ends.size() - index.partialSamples);
+        if (index.starts.empty()) {
+            index.dataStart = -1;
+        }
+        how = "extended";
+    } else {
+        string probe;
+        readRange(fd, 0, (info.st_size < 8192) ? info.st_size : 8192, probe);
+        index = LogFileIndex();
+        index.format = detectLogFormatFromProbe(probe, type);
+        index.dataStart = -1;
+        index.scannedEnd = 0;
+        index.partialSamples = 0;
+        index.columns = 0;
+    }
+    index.device = info.st_dev;
+    index.inode = info.st_ino;
+    index.modified = modificationTime(info);
+    scanLog(fd, index, type == "tree");
+    close(fd);
+    return how;
+}
+
+// *** Requests *** //
+
+static void relabelSample (LogFormat const& format, bool const& trees, string & out,
+    string const& line, int const& sampleNumber)
+{
+    if (!trees) {
+        relabelParameterLine(out, line, sampleNumber);
+        return;
+    }
+    withDialect(format, [&](auto dialect) {
+        relabelTreeLine<decltype(dialect)>(out, line, sampleNumber);
+    });
+}
+
+static void replyError (ostream & reply, string const& error) {
+    reply << "ERROR\t" << error << '\n';
+}
+
+// Last line of an OK reply: whether everything promised was sent
+static void finishReply (ostream & reply, string const& error) {
+    if (error.empty()) {
+        reply << "END\n";
+    } else {
+        replyError(reply, error);
+    }
+}
+
+static void answerCount (ostream & reply, string const& type, vector <LogFileIndex *> const& files) {
+    int numSamples = 0;
+    int nfiles = files.size();
+    for (int i = 1; i < nfiles && type == "parameter"; i++) {
+        if (files[i]->columns != files[0]->columns) {
+            replyError(reply, "number of parameters in file " + convertIntToString(i + 1)
+                + " does not match that from file 1");
+            return;
+        }
+    }
+    reply << "OK\n";
+    for (int i = 0; i < nfiles; i++) {
+        int fileSamples = files[i]->starts.size();
+        if (nfiles > 1) {
+            reply << "Read " << fileSamples << " samples from file " << (i + 1) << " of " << nfiles << "." << endl;
+        }
+        numSamples += fileSamples;
+    }
+    if (type == "tree") {
+        reply << "Read a total of " << numSamples << " tree samples." << endl;
+    } else {
+        reply << "Read a total of " << numSamples << " parameter samples (with " << files[0]->columns
+            << " columns)." << endl;
+    }
+    finishReply(reply, "");
+}
+
+// Opens every file before anything is sent, so a file removed since its index was
+// refreshed is reported as an error; fds.size() is the index of any that failed
+static bool openIndexedFiles (vector <string> const& fileNames, vector <int> & fds) {
+    for (size_t f = 0; f < fileNames.size(); f++) {
+        int fd = open(fileNames[f].c_str(), O_RDONLY);
+        if (fd < 0) {
+            for (size_t g = 0; g < fds.size(); g++) {
+                close(fds[g]);
+            }
+            fds.resize(f);
+            return false;
+        }
+        fds.push_back(fd);
+    }
+    return true;
+}
+
+static void answerThin (ostream & reply, string const& type, int const& thinning, int const& burnin,
+    string const& outputName, vector <string> const& fileNames, vector <LogFileIndex *> const& files)
+{
+    bool trees = (type == "tree");
+    bool toClient = isStandardStream(outputName);
+    ofstream outputFile;
+    if (!toClient) {
+        outputFile.open(outputName.c_str());
+        if (outputFile.fail()) {
+            replyError(reply, "unable to open file '" + outputName + "'");
+            return;
+        }
+    }
+    vector <int> fds;
+    if (!openIndexedFiles(fileNames, fds)) {
+        replyError(reply, "unable to open file '" + fileNames[fds.size()] + "'");
+        return;
+    }
+    reply << "OK\n";
+    ostream output(toClient ? reply.rdbuf() : outputFile.rdbuf());
+    ostringstream messages;
+
+    string line;
+    string outLine;
+    int totalSamples = 0;
+    int totalOriginal = 0;
+    string error;
+    for (size_t f = 0; f < files.size() && error.empty(); f++) {
+        LogFileIndex const& index = *files[f];
+        int fd = fds[f];
+    // header (everything before the first sample) only kept from the first file
+        if (f == 0) {
+            if (!readRange(fd, 0, index.dataStart < 0 ? index.size : index.dataStart, line)) {
+                error = "file '" + fileNames[f] + "' changed while being read; output is incomplete";
+            }
+            output << line;
+        }
+        int sampleCounter = 0;
+        int numSamples = index.starts.size();
+        for (int i = 0; i < numSamples && error.empty(); i++) {
+            if (!retainSample(i, burnin, thinning)) {
+                continue;
+            }
+            if (!readRange(fd, index.starts[i], index.ends[i], line)) {
+                error = "file '" + fileNames[f] + "' changed while being read; output is incomplete";
+                break;
+            }
+            outLine.clear();
+            relabelSample(index.format, trees, outLine, line, totalSamples);
+            outLine += '\n';
+            output.write(outLine.data(), outLine.size());
+            sampleCounter++;
+            totalSamples++;
+        }
+        totalOriginal += numSamples;
+        messages << "Retained " << sampleCounter << " of " << numSamples << " samples from file '"
+            << fileNames[f] << "' (" << logFormatName(index.format) << " format)." << endl;
+    }
+    for (size_t f = 0; f < fds.size(); f++) {
+        close(fds[f]);
+    }
+    if (trees && nexusTreeFormat(files[0]->format) && error.empty()) {
+        output << "End;" << endl;
+    }
+    output.flush();
+    if (!toClient) {
+        outputFile.close();
+        reply << messages.str() << endl;
+        if (error.empty()) {
+            reply << "Successfully created file '" << outputName << "', populated with " << totalSamples
+                << " samples (from original " << totalOriginal << " samples)." << endl;
+        }
+    }
+    finishReply(reply, error);
+}
+
+static void answerSlice (ostream & reply, int const& first, int const& num, string const& fileName,
+    LogFileIndex const& index)
+{
+    string line;
+    int numSamples = index.starts.size();
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        replyError(reply, "unable to open file '" + fileName + "'");
+        return;
+    }
+    reply << "OK\n";
+    string error;
+    for (int i = (first > 0 ? first : 0); i < first + num && i < numSamples; i++) {
+        if (!readRange(fd, index.starts[i], index.ends[i], line)) {
+            error = "file '" + fileName + "' changed while being read; output is incomplete";
+            break;
+        }
+        reply << line << '\n';
+    }
+    close(fd);
+    finishReply(reply, error);
+}
+
+// Returns false for 'stop'
+static bool answerRequest (string const& request, ostream & reply, map <string, LogFileIndex> & indexes) {
+    vector <string> fields = splitFields(request);
+    string command = fields[0];
+    if (command == "stop") {
+        reply << "OK\n" << "Server stopped." << endl;
+        finishReply(reply, "");
+        return false;
+    }
+    size_t firstFile = (command == "count") ? 2 : (command == "thin") ? 5 : (command == "slice") ? 4 : 0;
+    if (firstFile == 0 || fields.size() <= firstFile || (fields[1] != "tree" && fields[1] != "parameter")) {
+        replyError(reply, "malformed request");
+        return true;
+    }
+    string type = fields[1];
+    vector <string> fileNames(fields.begin() + firstFile, fields.end());
+    vector <LogFileIndex *> files;
+    for (size_t i = 0; i < fileNames.size(); i++) {
+        string key = type + '\t' + fileNames[i];
+        bool known = (indexes.count(key) != 0);
+        string error;
+        string how = refreshIndex(fileNames[i], type, indexes[key], known, error);
+        if (how.empty()) {
+            indexes.erase(key);
+            replyError(reply, error);
+            return true;
+        }
+        cout << "  " << fileNames[i] << ": " << how << " (" << indexes[key].starts.size() << " samples)" << endl;
+        files.push_back(&indexes[key]);
+    }
+    if (command == "count") {
+        answerCount(reply, type, files);
+    } else if (command == "thin") {
+        answerThin(reply, type, convertStringtoInt(fields[2]), convertStringtoInt(fields[3]), fields[4],
+            fileNames, files);
+    } else {
+        answerSlice(reply, convertStringtoInt(fields[2]), convertStringtoInt(fields[3]), fileNames[0], *files[0]);
+    }
+    return true;
+}
+
+// *** Server *** //
+
+static void removeSocketAndExit (int) {
+    unlink(serverSocketPath);
+    _exit(0);
+}
+
+static bool setSocketAddress (string const& socketPath, sockaddr_un & address) {
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    return true;
+}
+
+static int connectToServer (string const& socketPath) {
+    sockaddr_un address;
+    if (!setSocketAddress(socketPath, address)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void runLogServer (string const& socketPath) {
+    sockaddr_un address;
+    if (!setSocketAddress(socketPath, address)) {
+        cerr << "Error: socket path '" << socketPath << "' is too long. Exiting." << endl;
+        exit(1);
+    }
+    int running = connectToServer(socketPath);
+    if (running >= 0) {
+        close(running);
+        cerr << "Error: a server is already listening on '" << socketPath << "'. Exiting." << endl;
+        exit(1);
+    }
+    unlink(socketPath.c_str()); // left behind by a server that did not shut down cleanly
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        cerr << "Error: unable to listen on '" << socketPath << "': " << strerror(errno) << ". Exiting." << endl;
+        exit(1);
+    }
+    strncpy(serverSocketPath, socketPath.c_str(), sizeof(serverSocketPath) - 1);
+    signal(SIGPIPE, SIG_IGN); // a client hanging up mid-reply must not take the server down
+    signal(SIGINT, removeSocketAndExit);
+    signal(SIGTERM, removeSocketAndExit);
+
+    cout << "Serving requests on '" << socketPath << "'." << endl;
+
+    map <string, LogFileIndex> indexes;
+    bool serving = true;
+    string request;
+    while (serving) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        if (readRequestLine(client, request) && !request.empty()) {
+            cout << "Request: " << splitFields(request)[0] << endl;
+            SocketOutputBuffer replyBuffer(client);
+            ostream reply(&replyBuffer);
+            serving = answerRequest(request, reply, indexes);
+            reply.flush();
+        }
+        close(client);
+    }
+    close(listener);
+    unlink(socketPath.c_str());
+}
+
+// *** Client *** //
+
+// the server does not share our working directory
+static string absolutePath (string const& fileName) {
+    if (!fileName.empty() && fileName[0] == '/') {
+        return fileName;
+    }
+    char directory[PATH_MAX];
+    if (getcwd(directory, sizeof(directory)) == NULL) {
+        return fileName;
+    }
+    return string(directory) + "/" + fileName;
+}
+
+void sendLogServerRequest (LogServerOptions const& server, string const& fileName, string const& type,
+    int const& nruns, string & suffix, int const& thinning, int const& burnin, bool const& count,
+    bool & overwrite, string const& outputName)
+{
+    string request;
+    bool returnsSamples = false;
+
+    if (server.stop) {
+        request = "stop";
+    } else {
+        if (suffix.empty()) {
+            suffix = resolveDefaultSuffix(fileName, nruns, type);
+        }
+        string files;
+        for (int i = 0; i < nruns; i++) {
+            files += "\t" + absolutePath(runFileName(fileName, nruns, i, suffix));
+        }
+        if (server.sliceCount > 0) {
+            request = "slice\t" + type + "\t" + convertIntToString(server.sliceFirst) + "\t"
+                + convertIntToString(server.sliceCount) + files;
+            returnsSamples = true;
+        } else if (count) {
+            request = "count\t" + type + files;
+        } else {
+            string tempFileName = outputName.empty() ? thinnedFileName(fileName, thinning, burnin, nruns,
+                (type == "tree") ? "trees" : suffix) : outputName;
+            returnsSamples = isStandardStream(tempFileName);
+            if (!overwrite && !returnsSamples) {
+                bool validFileName = false;
+                while (!validFileName) {
+                    validFileName = checkValidOutputFile(tempFileName);
+                }
+            }
+            request = "thin\t" + type + "\t" + convertIntToString(thinning) + "\t" + convertIntToString(burnin)
+                + "\t" + (returnsSamples ? tempFileName : absolutePath(tempFileName)) + files;
+        }
+    }
+
+    int fd = connectToServer(server.clientSocket);
+    if (fd < 0) {
+        cerr << "Error: no server listening on '" << server.clientSocket << "'. Exiting." << endl;
+        exit(1);
+    }
+    request += '\n';
+    writeAll(fd, request.data(), request.size());
+
+    // status line, then messages (to cout) or samples (to standard output)
+    string status;
+    readRequestLine(fd, status);
+    if (status != "OK") {
+        cerr << "Error: " << (status.size() > 6 ? status.substr(6) : string("no reply from server"))
+            << ". Exiting." << endl;
+        exit(1);
+    }
+    streambuf * target = (returnsSamples && writingToStandardOutput()) ? standardOutputBuffer() : cout.rdbuf();
+    vector <char> buffer(1 << 16);
+    string pending; // the last line received, held back: the reply ends with END or ERROR
+    ssize_t numRead;
+    while ((numRead = read(fd, &buffer[0], buffer.size())) > 0) {
+    // pending holds no newline before its last character, so only the new bytes are searched
+        size_t from = pending.empty() ? 0 : pending.size() - 1;
+        pending.append(&buffer[0], numRead);
+        size_t lastLine = 0;
+        for (size_t i = pending.size() - 1; i > from; i--) {
+            if (pending[i - 1] == '\n') {
+                lastLine = i;
+                break;
+            }
+        }
+        target->sputn(pending.data(), lastLine);
+        pending.erase(0, lastLine);
+    }
+    target->pubsync();
+    close(fd);
+    if (pending != "END\n") {
+        string error = "incomplete reply from server";
+        if (pending.compare(0, 6, "ERROR\t") == 0) {
+            error = pending.substr(6, pending.find('\n') - 6);
+        }
+        cerr << "Error: " << error << ". Exiting." << endl;
+        exit(1);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef _LOGSERVER_H_
+#define _LOGSERVER_H_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include "logformat.h"
+
+using namespace std;
+
+// Long-lived server ('-serve socket') answering count/thin/slice requests from clients
+// ('-client socket') over a local Unix socket. For each log it keeps an index of where every
+// sample line starts and ends, plus the header and format, so repeated queries read only the
+// byte ranges they need. An index is checked against the file's fingerprint (device, inode,
+// size, modification time) on every request: a file that has only been appended to (e.g. a
+// running chain) is indexed from where the last scan stopped; anything else is rescanned.
+//
+// Requests are one tab-separated line:
+//   count  type file...
+//   thin   type thinning burnin output file...   (output '-' returns the samples themselves)
+//   slice  type first num file                   (samples first..first+num-1, as in the file)
+//   stop
+// Replies are 'OK' or 'ERROR<tab>message' on the first line, followed by messages or samples.
+// An OK reply ends with a line 'END', or 'ERROR<tab>message' if it could not be completed
+// (e.g. a file was truncated while being read); the client then exits with an error.
+
+struct LogServerOptions {
+    string serveSocket;  // '-serve path'
+    string clientSocket; // '-client path'
+    bool stop;           // '-stop': ask the server to exit
+    int sliceFirst;      // '-slice first num'
+    int sliceCount;
+};
+
+struct LogFileIndex {
+    // fingerprint
+    uint64_t device;
+    uint64_t inode;
+    long long size;
+    long long modified; // nanoseconds
+    LogFormat format;
+    long long dataStart;  // first sample line, or -1
+    long long scannedEnd; // just past the last complete line indexed
+    string scannedTail;   // bytes preceding scannedEnd, to recognise an appended file
+    int partialSamples;   // samples in an unterminated last line (re-indexed if the file grows)
+    int columns;          // parameter logs: header columns
+    vector <long long> starts; // sample lines [start, end)
+    vector <long long> ends;
+};
+
+void runLogServer (string const& socketPath);
+void sendLogServerRequest (LogServerOptions const& server, string const& fileName, string const& type,
+    int const& nruns, string & suffix, int const& thinning, int const& burnin, bool const& count,
+    bool & overwrite, string const& outputName);
+
+#endif /* _LOGSERVER_H_ */
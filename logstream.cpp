@@ -0,0 +1,80 @@
+
+#include <iostream>
+#include <stdlib.h>
+
+using namespace std;
+
+#include "translog.h"
+#include "logstream.h"
+
+// as for detectLogFormat
+static const size_t probeBytes = 8192;
+
+static streambuf * samplesBuffer = NULL; // standard output, once messages are diverted
+
+bool isStandardStream (string const& fileName) {
+    return fileName == "-";
+}
+
+// *** LogInput *** //
+
+LogInput::ProbedBuffer::ProbedBuffer (streambuf * source, size_t const& probeBytes)
+    : source_(source), probe_(probeBytes, '\0'), buffer_(1 << 16)
+{
+    streamsize numRead = source_->sgetn(&probe_[0], probeBytes);
+    probe_.resize(numRead > 0 ? numRead : 0);
+    if (!probe_.empty()) {
+        setg(&probe_[0], &probe_[0], &probe_[0] + probe_.size());
+    }
+}
+
+LogInput::ProbedBuffer::int_type LogInput::ProbedBuffer::underflow () {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    streamsize numRead = source_->sgetn(&buffer_[0], buffer_.size());
+    if (numRead <= 0) {
+        return traits_type::eof();
+    }
+    setg(&buffer_[0], &buffer_[0], &buffer_[0] + numRead);
+    return traits_type::to_int_type(*gptr());
+}
+
+LogInput::LogInput (string const& fileName, string const& type)
+    : buffer_(NULL), stream_(NULL), format_(FORMAT_MRBAYES)
+{
+    streambuf * source = cin.rdbuf();
+    if (!isStandardStream(fileName)) {
+        file_.open(fileName.c_str(), ios::binary);
+        if (file_.fail()) {
+            reportInputFileFailure(fileName);
+        }
+        cout << "Successfully opened file '" << fileName << "'." <<  endl << endl;
+        source = file_.rdbuf();
+    }
+    buffer_ = new ProbedBuffer(source, probeBytes);
+    format_ = detectLogFormatFromProbe(buffer_->probe(), type);
+    stream_.rdbuf(buffer_);
+}
+
+LogInput::~LogInput () {
+    stream_.rdbuf(NULL);
+    delete buffer_;
+}
+
+// *** Standard output *** //
+
+void useStandardOutputForSamples () {
+    if (samplesBuffer == NULL) {
+        samplesBuffer = cout.rdbuf();
+        cout.rdbuf(cerr.rdbuf());
+    }
+}
+
+bool writingToStandardOutput () {
+    return samplesBuffer != NULL;
+}
+
+streambuf * standardOutputBuffer () {
+    return samplesBuffer;
+}
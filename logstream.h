@@ -0,0 +1,49 @@
+#ifndef _LOGSTREAM_H_
+#define _LOGSTREAM_H_
+
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <vector>
+#include <string>
+
+#include "logformat.h"
+
+using namespace std;
+
+// A log opened for a single forward pass: a named file, or standard input for '-'.
+// The file is opened once; its format is detected from the first few KB as they are
+// read, and those bytes are then replayed to the reader, so nothing is ever re-read or sought.
+class LogInput {
+public:
+    LogInput (string const& fileName, string const& type);
+    ~LogInput ();
+    istream & stream () { return stream_; }
+    LogFormat format () const { return format_; }
+private:
+    class ProbedBuffer : public streambuf {
+    public:
+        ProbedBuffer (streambuf * source, size_t const& probeBytes);
+        string const& probe () const { return probe_; }
+    protected:
+        int_type underflow ();
+    private:
+        streambuf * source_;
+        string probe_;
+        vector <char> buffer_;
+    };
+    ifstream file_;
+    ProbedBuffer * buffer_;
+    istream stream_;
+    LogFormat format_;
+};
+
+// With '-' as output, thinned samples go to standard output and all progress
+// messages are moved to standard error
+void useStandardOutputForSamples ();
+bool writingToStandardOutput ();
+streambuf * standardOutputBuffer ();
+
+bool isStandardStream (string const& fileName);
+
+#endif /* _LOGSTREAM_H_ */
@@ -44,39 +44,143 @@ TODO: allow multiple files - DONE!
  - check that parameter log files all contain the same number of parameters
 TODO: allow newick trees
 TODO: allow arbitrarily named files passed in as a list
+TODO: serve multiple clients at once ('-serve' answers one request at a time)
 TODO: update argument parsing; use get_opt
 TODO: make sure memory kept low through streaming
+ - each log is read in one forward pass; '-' streams from standard input to standard output
 TODO: check translation tables are identical
 TODO: when multiple files involved, use multiple threads
+ - '-asdsf' reads each run on its own thread
 
-TODO: more default suffixes (i.e. BEAST ones: .log, .trees)
+TODO: more default suffixes (i.e. BEAST ones: .log, .trees) - DONE!
+ - format (MrBayes, BEAST, RevBayes, ExaBayes) is detected from the start of each file
 
 TODO: move over to phyx
 
 */
 
 #include <iostream>
+#include <fstream>
 #include <stdlib.h>
 
 using namespace std;
 
 #include "translog.h"
+#include "options.h"
+#include "shard.h"
+#include "asdsf.h"
+#include "logstream.h"
+#include "tail.h"
+#include "logserver.h"
 
 int main(int argc, char *argv[]) {
-    string fileName;
-    string type;
-    string suffix;
-    int thinning = 1;
-    int burnin = 0;
-    int nruns = 1;
-    bool count = false;
-    bool overwrite = false;
-
+    ProgramOptions options;
+    
+    ios_base::sync_with_stdio(false);
+    processCommandLineArguments(argc, argv, options);
+    string & outputName = options.outputName;
+    LogServerOptions const& server = options.server;
+    
+    bool outputNamed = !outputName.empty(); // '-o'
+    bool fromStandardInput = isStandardStream(options.fileName);
+    if ((fromStandardInput || server.sliceCount > 0) && outputName.empty()) {
+        outputName = "-";
+    }
+    if (isStandardStream(outputName)) {
+        useStandardOutputForSamples(); // keep standard output for the samples themselves
+    }
     printProgramInfo();
-    processCommandLineArguments(argc, argv, fileName, thinning, burnin, type,
-        nruns, suffix, count, overwrite);
     
-    if (count) { // simply count number of samples present i.e. file may be too large to read it directly
+    bool sharded = !options.shardMode.empty();
+    bool namesChanged = (options.nameMode != NAMES_NUMERIC);
+    if (fromStandardInput && (options.nruns > 1 || sharded || options.asdsf || options.decode)) {
+        cerr << "Error: standard input ('-') holds a single log; it cannot be combined with '-r', '-asdsf',"
+            << " '-decode' or sharded thinning. Exiting." << endl;
+        exit(1);
+    }
+    if (options.binary.enabled && isStandardStream(outputName)) {
+        cerr << "Error: '-binary' output must go to a named file ('-o'). Exiting." << endl;
+        exit(1);
+    }
+    if (options.last > 0 && (options.burnin != 0 || options.count || options.asdsf || options.decode
+        || options.binary.enabled || namesChanged || sharded || fromStandardInput))
+    {
+        cerr << "Error: '--last' reads backward from the end of named files; it replaces '-b' and cannot be"
+            << " combined with '-count', '-asdsf', '-decode', '-binary', '-names' or sharded thinning. Exiting." << endl;
+        exit(1);
+    }
+    bool serverMode = !server.serveSocket.empty() || !server.clientSocket.empty();
+    if (serverMode && (fromStandardInput || options.last > 0 || options.asdsf || options.decode
+        || options.binary.enabled || namesChanged || sharded))
+    {
+        cerr << "Error: '-serve' and '-client' handle counting, thinning and slices of named files only. Exiting." << endl;
+        exit(1);
+    }
+    if ((server.sliceCount > 0 || server.stop) && server.clientSocket.empty()) {
+        cerr << "Error: '-slice' and '-stop' are requests to a server ('-client socket'). Exiting." << endl;
+        exit(1);
+    }
+    if (server.sliceCount > 0 && options.nruns > 1) {
+        cerr << "Error: '-slice' reads from a single file. Exiting." << endl;
+        exit(1);
+    }
+    if (options.numeric.enabled && (options.type != "parameter" || options.last > 0 || options.count
+        || serverMode || sharded))
+    {
+        cerr << "Error: '-digits', '-fixed' and '-csv' apply to thinning parameter files ('-p'), and cannot"
+            << " be combined with '--last', '-count', server requests or sharded thinning. Exiting." << endl;
+        exit(1);
+    }
+    if (fromStandardInput && !options.overwrite && !isStandardStream(outputName) && ifstream(outputName.c_str())) {
+        // cannot ask: the answer would be read from the log itself
+        cerr << "Error: output file '" << outputName << "' exists; use '-overwrite' to replace it. Exiting." << endl;
+        exit(1);
+    }
+    if (sharded && (namesChanged || options.binary.enabled)) {
+        cerr << "Error: '-names' and '-binary' cannot be combined with sharded thinning. Exiting." << endl;
+        exit(1);
+    }
+    if (outputNamed && (options.shardMode == "count" || options.shardMode == "thin" || options.asdsf
+        || options.count))
+    {
+        cerr << "Error: '-o' names the thinned output; '-shard' and '-shardcount' write per-shard files, and"
+            << " '-count' and '-asdsf' only report. Exiting." << endl;
+        exit(1);
+    }
+    if (options.binary.enabled && namesChanged) {
+        cerr << "Error: '-binary' output keeps the translate table; do not combine with '-names'. Exiting." << endl;
+        exit(1);
+    }
+    
+    string const& fileName = options.fileName;
+    string const& type = options.type;
+    string & suffix = options.suffix;
+    int const& thinning = options.thinning;
+    int const& burnin = options.burnin;
+    int const& nruns = options.nruns;
+    bool & overwrite = options.overwrite;
+    if (!server.serveSocket.empty()) {
+        runLogServer(server.serveSocket);
+    } else if (!server.clientSocket.empty()) {
+        sendLogServerRequest(server, fileName, type, nruns, suffix, thinning, burnin, options.count, overwrite,
+            outputName);
+    } else if (options.shardMode == "count") {
+        countShardSamples(fileName, type, nruns, suffix, thinning, burnin, options.shard, options.nshards);
+    } else if (options.shardMode == "thin") {
+        thinShard(fileName, type, nruns, suffix, thinning, burnin, options.shard, options.nshards);
+    } else if (options.shardMode == "merge") {
+        mergeShards(fileName, type, nruns, suffix, thinning, burnin, options.nshards, overwrite, outputName);
+    } else if (options.decode) {
+        convertTreeBinaryToNexus(fileName, thinning, burnin, overwrite, outputName);
+    } else if (options.asdsf) {
+        if (type != "tree") {
+            cerr << "Error: '-asdsf' requires tree files ('-t'). Exiting." << endl;
+            exit(1);
+        }
+        computeASDSF(fileName, nruns, suffix, thinning, burnin);
+    } else if (options.last > 0) {
+        collectLastSamples(fileName, type, nruns, suffix, options.last, thinning, overwrite, outputName);
+    } else if (options.count) { // simply count number of samples present i.e. file may be too large to read it directly
         if (type == "tree") {
             countTreeSamples(fileName, nruns, suffix);
         } else if (type == "parameter") {
@@ -84,16 +188,14 @@ int main(int argc, char *argv[]) {
         }
     } else {
         if (type == "tree") {
-            collectTreesAndThin(fileName, thinning, burnin, suffix, nruns, overwrite);
+            collectTreesAndThin(fileName, thinning, burnin, suffix, nruns, overwrite, options.nameMode,
+                options.binary, outputName);
         } else if (type == "parameter") {
-            collectParametersAndThin(fileName, thinning, burnin, nruns, suffix, overwrite);
+            collectParametersAndThin(fileName, thinning, burnin, nruns, suffix, overwrite, outputName,
+                options.numeric);
         }
     }
     
     cout << endl << "Fin." << endl;
     return 0;
 }
-
-
-
-
@@ -0,0 +1,204 @@
+
+#include <iostream>
+#include <charconv>
+#include <cmath>
+#include <stdlib.h>
+
+using namespace std;
+
+#include "translog.h"
+#include "logformat.h"
+#include "numericlog.h"
+
+size_t appendDelimitedTokens (string & out, string const& line, size_t pos, char const& delimiter) {
+    size_t len = line.size();
+    size_t numTokens = 0;
+    pos = skipWhiteSpace(line, pos);
+    while (pos < len) {
+        size_t end = skipToken(line, pos);
+        if (numTokens > 0) {
+            out += delimiter;
+        }
+        out.append(line, pos, end - pos);
+        numTokens++;
+        pos = skipWhiteSpace(line, end);
+    }
+    return numTokens;
+}
+
+size_t countColumns (string const& line) {
+    size_t len = line.size();
+    size_t numTokens = 0;
+    size_t pos = skipWhiteSpace(line, 0);
+    while (pos < len) {
+        numTokens++;
+        pos = skipWhiteSpace(line, skipToken(line, pos));
+    }
+    return numTokens;
+}
+
+static const long long powersOfTen[] = {1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL,
+    10000000LL, 100000000LL, 1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL,
+    10000000000000LL, 100000000000000LL, 1000000000000000LL};
+static const int maxFastDecimals = 12;
+
+// |value| scaled to a whole number of 10^-decimals units; false when out of the fast range.
+// Below 1e12 the scaled product is within 1e-4 of exact, so rounding it gives the same
+// result as exact decimal rounding (as printf/to_chars do) unless it lies close to a tie;
+// those are left to to_chars.
+static bool scaledUnits (double const& value, int const& decimals, long long & units) {
+    if (decimals < 0 || decimals > maxFastDecimals) {
+        return false;
+    }
+    double scaled = fabs(value) * (double)powersOfTen[decimals];
+    if (!(scaled < 1e12)) { // also rejects nan and inf
+        return false;
+    }
+    double whole = floor(scaled);
+    if (fabs(scaled - whole - 0.5) < 1e-3) {
+        return false;
+    }
+    units = (long long)whole + (scaled - whole > 0.5 ? 1 : 0);
+    return true;
+}
+
+// value rounded to a number of decimal places via a scaled integer, which is several times
+// faster than to_chars with a precision; false when out of range (to_chars is used instead).
+// As printf, negative values keep their sign even when they round to zero (e.g. '-0.000').
+static bool appendScaledFixed (string & out, double const& value, int const& decimals, bool const& trimZeros) {
+    long long units;
+    if (!scaledUnits(value, decimals, units)) {
+        return false;
+    }
+    if (signbit(value)) {
+        out += '-';
+    }
+    char digits[24];
+    to_chars_result written = to_chars(digits, digits + sizeof(digits), units / powersOfTen[decimals]);
+    out.append(digits, written.ptr);
+    if (decimals == 0) {
+        return true;
+    }
+    long long fraction = units % powersOfTen[decimals];
+    int numDigits = decimals;
+    if (trimZeros) {
+        while (numDigits > 0 && fraction % 10 == 0) {
+            fraction /= 10;
+            numDigits--;
+        }
+        if (numDigits == 0) {
+            return true;
+        }
+    }
+    out += '.';
+    for (int i = numDigits - 1; i >= 0; i--) {
+        digits[i] = '0' + (char)(fraction % 10);
+        fraction /= 10;
+    }
+    out.append(digits, numDigits);
+    return true;
+}
+
+// as printf's %g: plain notation when the decimal exponent is in [-4, precision)
+static bool appendFastGeneral (string & out, double const& value, int const& precision) {
+    static const double lowerBounds[] = {1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+        1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17};
+    if (value == 0.0) {
+        out += signbit(value) ? "-0" : "0";
+        return true;
+    }
+    double magnitude = fabs(value);
+    if (precision > maxFastDecimals || !(magnitude >= lowerBounds[0])
+        || magnitude >= lowerBounds[precision + 4])
+    {
+        return false;
+    }
+    int exponent = precision - 1;
+    while (magnitude < lowerBounds[exponent + 4]) {
+        exponent--;
+    }
+// the exponent is that of the rounded value: rounding can carry into another digit
+// (9.9996 -> 10.00), which may also call for exponent notation (9999.9 -> 1e+04)
+    int decimals = precision - 1 - exponent;
+    long long units;
+    if (!scaledUnits(value, decimals, units)) {
+        return false;
+    }
+    if (units >= powersOfTen[precision]) {
+        exponent++;
+        decimals--;
+        if (exponent >= precision) {
+            return false;
+        }
+    }
+    return appendScaledFixed(out, value, decimals, true);
+}
+
+// Writes one value; anything that does not parse completely as a (non-integer) number is kept as is
+static void appendNumericValue (string & out, const char * first, const char * last,
+    NumericOutputOptions const& numeric)
+{
+    long long integer;
+    from_chars_result asInteger = from_chars(first, last, integer);
+    if (asInteger.ec == errc() && asInteger.ptr == last) {
+        out.append(first, last);
+        return;
+    }
+    double value;
+    from_chars_result asDouble = from_chars(first, last, value);
+    if (asDouble.ec != errc() || asDouble.ptr != last) {
+        out.append(first, last);
+        return;
+    }
+    if (numeric.fixed ? appendScaledFixed(out, value, numeric.precision, false)
+        : appendFastGeneral(out, value, numeric.precision))
+    {
+        return;
+    }
+    char buffer[64];
+    to_chars_result written = numeric.fixed
+        ? to_chars(buffer, buffer + sizeof(buffer), value, chars_format::fixed, numeric.precision)
+        : to_chars(buffer, buffer + sizeof(buffer), value, chars_format::general, numeric.precision);
+    if (written.ec != errc()) {
+        out.append(first, last); // too wide for the buffer (huge fixed-point values)
+        return;
+    }
+    out.append(buffer, written.ptr);
+}
+
+size_t appendNumericRow (string & out, string const& line, int const& sampleNumber,
+    NumericOutputOptions const& numeric)
+{
+    size_t pos = skipWhiteSpace(line, 0);
+    if (pos == line.size()) {
+        return 0;
+    }
+    pos = skipToken(line, pos);
+    out += to_string(sampleNumber);
+    size_t len = line.size();
+    size_t numColumns = 1; // counted as written: one delimiter per further column
+    const char * data = line.data();
+    pos = skipWhiteSpace(line, pos);
+    while (pos < len) {
+        size_t end = skipToken(line, pos);
+        out += numeric.delimiter;
+        if (numeric.precision == 0) {
+            out.append(line, pos, end - pos);
+        } else {
+            appendNumericValue(out, data + pos, data + end, numeric);
+        }
+        numColumns++;
+        pos = skipWhiteSpace(line, end);
+    }
+    return numColumns;
+}
+
+int parsePrecision (string const& option, int const& maximum) {
+    int precision = convertStringtoInt(option);
+    if (precision < 1 || precision > maximum) {
+        cerr << "Error: precision must be between 1 and " << maximum << " (got '" << option
+            << "'). Exiting." << endl;
+        exit(1);
+    }
+    return precision;
+}
@@ -0,0 +1,33 @@
+#ifndef _NUMERICLOG_H_
+#define _NUMERICLOG_H_
+
+#include <string>
+
+using namespace std;
+
+// Numeric re-emission of parameter samples ('-digits', '-fixed', '-csv'). Each value is parsed
+// (std::from_chars) and written back with the requested precision, which for full-precision
+// logs roughly halves the output. Integer columns (e.g. generation, counts) and anything that
+// is not a number are copied unchanged. Every row is checked against the header's column count.
+
+struct NumericOutputOptions {
+    bool enabled;
+    int precision;   // significant digits (or decimal places if fixed); 0 = values as written
+    bool fixed;      // fixed-point rather than shortest general notation
+    char delimiter;  // '\t' or ','
+};
+
+// plain thinning: rows copied token by token
+const NumericOutputOptions valuesAsWritten = {false, 0, false, '\t'};
+
+// Appends the tokens of line from pos, joined by the delimiter; returns the number of tokens
+size_t appendDelimitedTokens (string & out, string const& line, size_t pos, char const& delimiter);
+
+// The first column is replaced by sampleNumber; returns the number of columns in the row
+size_t appendNumericRow (string & out, string const& line, int const& sampleNumber,
+    NumericOutputOptions const& numeric);
+
+size_t countColumns (string const& line);
+int parsePrecision (string const& option, int const& maximum);
+
+#endif /* _NUMERICLOG_H_ */
@@ -0,0 +1,38 @@
+#ifndef _OPTIONS_H_
+#define _OPTIONS_H_
+
+#include <string>
+
+#include "translate.h"
+#include "treebinary.h"
+#include "logserver.h"
+#include "numericlog.h"
+
+using namespace std;
+
+// Everything that can be given on the command line (see printProgramUsage), with its default
+struct ProgramOptions {
+    string fileName;
+    string type;         // 'tree' ('-t') or 'parameter' ('-p')
+    string suffix;
+    int thinning = 1;
+    int burnin = 0;
+    int nruns = 1;
+    bool count = false;
+    bool overwrite = false;
+    string shardMode;    // 'count', 'thin' or 'merge'
+    int shard = 0;
+    int nshards = 0;
+    TreeNameMode nameMode = NAMES_NUMERIC;
+    bool asdsf = false;
+    BinaryTreeOptions binary = {false, LENGTHS_QUANTIZED, 6};
+    bool decode = false;
+    string outputName;   // '-o'
+    int last = 0;        // '--last'
+    LogServerOptions server = {"", "", false, 0, 0};
+    NumericOutputOptions numeric = valuesAsWritten;
+};
+
+void processCommandLineArguments (int argc, char *argv[], ProgramOptions & options);
+
+#endif /* _OPTIONS_H_ */
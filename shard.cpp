@@ -0,0 +1,404 @@
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+#include "translog.h"
+#include "logformat.h"
+#include "logstream.h"
+#include "numericlog.h"
+#include "shard.h"
+
+// Read-only stream over bytes [start, end) of an open file, so the ordinary
+// per-file workers can be pointed at one shard's piece of it
+class ByteRangeBuffer : public streambuf {
+public:
+    ByteRangeBuffer (ifstream & input, long long const& start, long long const& end)
+        : input_(input), remaining_(end - start), buffer_(1 << 16)
+    {
+        input_.clear();
+        input_.seekg(start);
+    }
+protected:
+    int_type underflow () {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        if (remaining_ <= 0) {
+            return traits_type::eof();
+        }
+        long long toRead = remaining_ < (long long)buffer_.size() ? remaining_ : (long long)buffer_.size();
+        input_.read(&buffer_[0], toRead);
+        long long numRead = input_.gcount();
+        if (numRead <= 0) {
+            return traits_type::eof();
+        }
+        remaining_ -= numRead;
+        setg(&buffer_[0], &buffer_[0], &buffer_[0] + numRead);
+        return traits_type::to_int_type(*gptr());
+    }
+private:
+    ifstream & input_;
+    long long remaining_;
+    vector <char> buffer_;
+};
+
+static long long getFileSize (string const& fileName) {
+    ifstream input(fileName.c_str(), ios::binary | ios::ate);
+    return (long long)input.tellg();
+}
+
+// Moves a raw byte offset to the start of the line that owns it: the first
+// line starting at or after pos. Adjacent shards therefore agree on boundaries.
+static long long alignToLineStart (ifstream & input, long long const& pos, long long const& fileSize) {
+    if (pos <= 0) {
+        return 0;
+    }
+    if (pos >= fileSize) {
+        return fileSize;
+    }
+    input.clear();
+    input.seekg(pos - 1);
+    char c;
+    long long current = pos - 1;
+    while (input.get(c)) {
+        if (c == '\n') {
+            return current + 1;
+        }
+        current++;
+    }
+    return fileSize;
+}
+
+vector <ShardPiece> planShardPieces (vector <long long> const& fileSizes, int const& shard,
+    int const& nshards)
+{
+    vector <ShardPiece> pieces;
+    int nfiles = fileSizes.size();
+
+    if (nshards <= nfiles) {
+    // whole runs per shard
+        for (int i = 0; i < nfiles; i++) {
+            if ((long long)i * nshards / nfiles == shard - 1) {
+                ShardPiece piece = {i, 0, fileSizes[i], 0, 0};
+                pieces.push_back(piece);
+            }
+        }
+        return pieces;
+    }
+
+// otherwise split the concatenation of all runs into equal byte ranges
+    long long totalBytes = 0;
+    for (int i = 0; i < nfiles; i++) {
+        totalBytes += fileSizes[i];
+    }
+    long long lo = totalBytes * (shard - 1) / nshards;
+    long long hi = totalBytes * shard / nshards;
+    long long offset = 0;
+    for (int i = 0; i < nfiles; i++) {
+        long long fileStart = offset;
+        long long fileEnd = offset + fileSizes[i];
+        offset = fileEnd;
+        long long start = lo > fileStart ? lo : fileStart;
+        long long end = hi < fileEnd ? hi : fileEnd;
+        if (start < end) {
+            ShardPiece piece = {i, start - fileStart, end - fileStart, 0, 0};
+            pieces.push_back(piece);
+        }
+    }
+    return pieces;
+}
+
+string shardFileName (string const& outputFileName, int const& shard, int const& nshards,
+    string const& extension)
+{
+    return outputFileName + ".shard-" + convertIntToString(shard) + "-of-"
+        + convertIntToString(nshards) + "." + extension;
+}
+
+static string shardOutputFileName (string const& fileName, string const& type, int const& nruns,
+    string & suffix, int const& thinning, int const& burnin)
+{
+    if (suffix.empty()) {
+        suffix = resolveDefaultSuffix(fileName, nruns, type);
+    }
+    return thinnedFileName(fileName, thinning, burnin, nruns, (type == "tree") ? "trees" : suffix);
+}
+
+static void checkShardArguments (int const& shard, int const& nshards) {
+    if (nshards < 1 || shard < 1 || shard > nshards) {
+        cerr << "Error: shard (" << shard << ") must be between 1 and the number of shards ("
+            << nshards << "). Exiting." << endl;
+        exit(1);
+    }
+}
+
+// Plans this shard's pieces and aligns them to line boundaries
+static vector <ShardPiece> alignedShardPieces (string const& fileName, int const& nruns,
+    string const& suffix, int const& shard, int const& nshards)
+{
+    vector <long long> fileSizes;
+    for (int i = 0; i < nruns; i++) {
+        string currentFile = runFileName(fileName, nruns, i, suffix);
+        checkValidInputFile(currentFile);
+        fileSizes.push_back(getFileSize(currentFile));
+    }
+    vector <ShardPiece> pieces = planShardPieces(fileSizes, shard, nshards);
+    for (size_t j = 0; j < pieces.size(); j++) {
+        ifstream input(runFileName(fileName, nruns, pieces[j].fileIndex, suffix).c_str(), ios::binary);
+        long long fileSize = fileSizes[pieces[j].fileIndex];
+        pieces[j].start = alignToLineStart(input, pieces[j].start, fileSize);
+        pieces[j].end = alignToLineStart(input, pieces[j].end, fileSize);
+    }
+    return pieces;
+}
+
+// Reads 'piece fileIndex start end samples [retained]' lines from a count or shard manifest
+static bool readShardManifest (string const& manifestName, vector <ShardPiece> & pieces, int & format) {
+    ifstream manifest(manifestName.c_str());
+    if (manifest.fail()) {
+        return false;
+    }
+    string line;
+    while (getline(manifest, line)) {
+        istringstream tokens(line);
+        string key;
+        tokens >> key;
+        if (key == "piece") {
+            ShardPiece piece = {0, 0, 0, 0, 0};
+            tokens >> piece.fileIndex >> piece.start >> piece.end >> piece.samples >> piece.retained;
+            pieces.push_back(piece);
+        } else if (key == "format") {
+            tokens >> format;
+        }
+    }
+    return true;
+}
+
+void countShardSamples (string const& fileName, string const& type, int const& nruns,
+    string & suffix, int const& thinning, int const& burnin, int const& shard, int const& nshards)
+{
+    checkShardArguments(shard, nshards);
+    string outputFileName = shardOutputFileName(fileName, type, nruns, suffix, thinning, burnin);
+    vector <ShardPiece> pieces = alignedShardPieces(fileName, nruns, suffix, shard, nshards);
+
+    cout << "COUNTING SAMPLES FOR SHARD " << shard << " OF " << nshards << "..." << endl << endl;
+
+    string countName = shardFileName(outputFileName, shard, nshards, "count");
+    ofstream countManifest(countName.c_str());
+    for (size_t j = 0; j < pieces.size(); j++) {
+        string currentFile = runFileName(fileName, nruns, pieces[j].fileIndex, suffix);
+        LogFormat format = detectLogFormat(currentFile, type);
+        ifstream input(currentFile.c_str(), ios::binary);
+        ByteRangeBuffer range(input, pieces[j].start, pieces[j].end);
+        istream pieceInput(&range);
+
+        if (type == "tree") {
+            pieces[j].samples = countTreeStream(format, pieceInput);
+        } else {
+            pieces[j].samples = countParameterRows(format, pieceInput);
+        }
+        countManifest << "piece " << pieces[j].fileIndex << " " << pieces[j].start << " "
+            << pieces[j].end << " " << pieces[j].samples << endl;
+        cout << "Read " << pieces[j].samples << " samples from bytes " << pieces[j].start << "-"
+            << pieces[j].end << " of file '" << currentFile << "'." << endl;
+    }
+    countManifest.close();
+
+    cout << endl << "Successfully created file '" << countName << "'." << endl;
+}
+
+// Number of samples in the given file preceding byte offset 'start', from the count
+// manifests of all earlier shards
+static int samplesBefore (string const& outputFileName, int const& fileIndex, long long const& start,
+    int const& shard, int const& nshards)
+{
+    if (start == 0) {
+        return 0;
+    }
+    int preceding = 0;
+    for (int k = 1; k < shard; k++) {
+        string countName = shardFileName(outputFileName, k, nshards, "count");
+        vector <ShardPiece> counted;
+        int format = 0;
+        if (!readShardManifest(countName, counted, format)) {
+            cerr << "Error: unable to open sample count file '" << countName << "'. Run each shard with"
+                << " '-shardcount' first. Exiting." << endl;
+            exit(1);
+        }
+        for (size_t j = 0; j < counted.size(); j++) {
+            if (counted[j].fileIndex == fileIndex && counted[j].end <= start) {
+                preceding += counted[j].samples;
+            }
+        }
+    }
+    return preceding;
+}
+
+void thinShard (string const& fileName, string const& type, int const& nruns, string & suffix,
+    int const& thinning, int const& burnin, int const& shard, int const& nshards)
+{
+    checkShardArguments(shard, nshards);
+    string outputFileName = shardOutputFileName(fileName, type, nruns, suffix, thinning, burnin);
+    vector <ShardPiece> pieces = alignedShardPieces(fileName, nruns, suffix, shard, nshards);
+    LogFormat outputFormat = detectLogFormat(runFileName(fileName, nruns, 0, suffix), type);
+
+    cout << "THINNING SHARD " << shard << " OF " << nshards << "..." << endl << endl;
+
+    string partName = shardFileName(outputFileName, shard, nshards, "part");
+    ofstream partOutput(partName.c_str());
+    int localSamples = 0; // renumbered globally when merged
+
+    for (size_t j = 0; j < pieces.size(); j++) {
+        string currentFile = runFileName(fileName, nruns, pieces[j].fileIndex, suffix);
+        LogFormat format = detectLogFormat(currentFile, type);
+        ifstream input(currentFile.c_str(), ios::binary);
+        ByteRangeBuffer range(input, pieces[j].start, pieces[j].end);
+        istream pieceInput(&range);
+
+        int firstSample = samplesBefore(outputFileName, pieces[j].fileIndex, pieces[j].start, shard, nshards);
+        int sampleCounter = firstSample;
+        int retained = 0;
+        bool keepHeader = (pieces[j].fileIndex == 0);
+        if (type == "tree") {
+            thinTreeStream(format, pieceInput, partOutput, keepHeader, NAMES_NUMERIC, thinning, burnin,
+                sampleCounter, retained, localSamples);
+        } else {
+            thinParameterStream(format, pieceInput, partOutput, keepHeader, valuesAsWritten, thinning, burnin,
+                sampleCounter, retained, localSamples);
+        }
+        pieces[j].samples = sampleCounter - firstSample;
+        pieces[j].retained = retained;
+        cout << "Retained " << retained << " of " << pieces[j].samples << " samples from bytes "
+            << pieces[j].start << "-" << pieces[j].end << " of file '" << currentFile << "'." << endl;
+    }
+    partOutput.close();
+
+    string manifestName = shardFileName(outputFileName, shard, nshards, "manifest");
+    ofstream manifest(manifestName.c_str());
+    manifest << "type " << type << endl;
+    manifest << "format " << (int)outputFormat << endl;
+    for (size_t j = 0; j < pieces.size(); j++) {
+        manifest << "piece " << pieces[j].fileIndex << " " << pieces[j].start << " " << pieces[j].end
+            << " " << pieces[j].samples << " " << pieces[j].retained << endl;
+    }
+    manifest.close();
+
+    cout << endl << "Successfully created files '" << partName << "' and '" << manifestName << "'." << endl;
+}
+
+template <typename Dialect>
+static void renumberShardStreamAs (istream & partInput, ostream & output, string const& type,
+    int & totalSamples)
+{
+    string line;
+    string outLine;
+    bool treeLog = (type == "tree");
+    while (getline(partInput, line)) {
+        LineKind kind = treeLog ? classifyTreeLine<Dialect>(line) : classifyParameterLine<Dialect>(line);
+        if (kind != LINE_SAMPLE) {
+            output << line << '\n';
+            continue;
+        }
+        outLine.clear();
+        if (treeLog) {
+            relabelTreeLine<Dialect>(outLine, line, totalSamples);
+        } else {
+            relabelParameterLine(outLine, line, totalSamples);
+        }
+        outLine += '\n';
+        output.write(outLine.data(), outLine.size());
+        totalSamples++;
+    }
+}
+
+static void renumberShardStream (LogFormat const& format, istream & partInput, ostream & output,
+    string const& type, int & totalSamples)
+{
+    withDialect(format, [&](auto dialect) {
+        renumberShardStreamAs<decltype(dialect)>(partInput, output, type, totalSamples);
+    });
+}
+
+void mergeShards (string const& fileName, string const& type, int const& nruns, string & suffix,
+    int const& thinning, int const& burnin, int const& nshards, bool & overwrite, string const& outputName)
+{
+    checkShardArguments(1, nshards);
+// the shards' scratch files are named after the default output, whatever the merged file is called
+    string outputFileName = shardOutputFileName(fileName, type, nruns, suffix, thinning, burnin);
+    string mergedFileName = outputName.empty() ? outputFileName : outputName;
+    bool toStandardOutput = isStandardStream(mergedFileName);
+
+// check all shards are present before writing anything
+    int format = 0;
+    int totalOriginal = 0;
+    int totalRetained = 0;
+    for (int k = 1; k <= nshards; k++) {
+        string manifestName = shardFileName(outputFileName, k, nshards, "manifest");
+        vector <ShardPiece> pieces;
+        if (!readShardManifest(manifestName, pieces, format)) {
+            cerr << "Error: unable to open shard manifest '" << manifestName << "'. Exiting." << endl;
+            exit(1);
+        }
+        for (size_t j = 0; j < pieces.size(); j++) {
+            totalOriginal += pieces[j].samples;
+            totalRetained += pieces[j].retained;
+        }
+    }
+
+    if (!overwrite && !toStandardOutput) {
+        bool validFileName = false;
+        while (!validFileName) {
+            validFileName = checkValidOutputFile(mergedFileName);
+        }
+    }
+
+    cout << "MERGING " << nshards << " SHARDS..." << endl << endl;
+
+    ofstream outputFile;
+    if (!toStandardOutput) {
+        outputFile.open(mergedFileName.c_str());
+    }
+    ostream output(toStandardOutput ? standardOutputBuffer() : outputFile.rdbuf());
+    int totalSamples = 0;
+    for (int k = 1; k <= nshards; k++) {
+        string partName = shardFileName(outputFileName, k, nshards, "part");
+        ifstream partInput(partName.c_str());
+        if (partInput.fail()) {
+            cerr << "Error: unable to open shard output '" << partName << "'. Exiting." << endl;
+            exit(1);
+        }
+        renumberShardStream((LogFormat)format, partInput, output, type, totalSamples);
+    }
+    if (type == "tree" && nexusTreeFormat((LogFormat)format)) {
+        output << "End;" << endl;
+    }
+    output.flush();
+    outputFile.close();
+
+    if (totalSamples != totalRetained) {
+        cerr << "Error: shard outputs hold " << totalSamples << " samples but manifests list "
+            << totalRetained << ". Shard files retained for inspection." << endl;
+        exit(1);
+    }
+
+// scratch files no longer needed
+    for (int k = 1; k <= nshards; k++) {
+        remove(shardFileName(outputFileName, k, nshards, "part").c_str());
+        remove(shardFileName(outputFileName, k, nshards, "manifest").c_str());
+        remove(shardFileName(outputFileName, k, nshards, "count").c_str());
+    }
+
+    if (toStandardOutput) {
+        cout << "Wrote " << totalSamples << " samples (from original " << totalOriginal
+            << " samples) to standard output." << endl;
+    } else {
+        cout << "Successfully created file '" << mergedFileName << "', populated with " << totalSamples
+            << " samples (from original " << totalOriginal << " samples)." << endl;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Multi-process (e.g. cluster) thinning. The inputs are divided among nshards processes:
+// whole runs when there are at least as many runs as shards, otherwise byte ranges.
+// A shard owns every line that starts within its byte range.
+//
+//   -shardcount k K : count samples in shard k's pieces (only needed for byte ranges)
+//   -shard k K      : thin shard k, writing a partial output and a manifest
+//   -merge K        : renumber and concatenate the partial outputs into the usual output file
+//
+// The merged file is identical to that of a single-process run.
+
+struct ShardPiece {
+    int fileIndex;   // run (0-based)
+    long long start; // byte range within the file, aligned to line starts
+    long long end;
+    int samples;     // total samples in range
+    int retained;    // samples kept after burnin/thinning
+};
+
+vector <ShardPiece> planShardPieces (vector <long long> const& fileSizes, int const& shard,
+    int const& nshards);
+string shardFileName (string const& outputFileName, int const& shard, int const& nshards,
+    string const& extension);
+
+void countShardSamples (string const& fileName, string const& type, int const& nruns,
+    string & suffix, int const& thinning, int const& burnin, int const& shard, int const& nshards);
+void thinShard (string const& fileName, string const& type, int const& nruns, string & suffix,
+    int const& thinning, int const& burnin, int const& shard, int const& nshards);
+void mergeShards (string const& fileName, string const& type, int const& nruns, string & suffix,
+    int const& thinning, int const& burnin, int const& nshards, bool & overwrite, string const& outputName);
+
+#endif /* _SHARD_H_ */
@@ -0,0 +1,220 @@
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+#include "translog.h"
+#include "logformat.h"
+#include "logstream.h"
+#include "numericlog.h"
+#include "tail.h"
+
+static const long long tailBlockBytes = 1 << 20;
+
+// Offset of the first sample line. Everything before it is the header; written to
+// output (as ordinary thinning would) when header is non-null.
+template <typename Dialect>
+static long long findDataStartAs (ifstream & input, bool const& trees, ostream * header) {
+    string line;
+    input.clear();
+    input.seekg(0);
+    long long start = 0;
+    while (getline(input, line)) {
+        if (classifyLineAs<Dialect>(line, trees) == LINE_SAMPLE) {
+            return start;
+        }
+        if (header != NULL) {
+            *header << line << '\n';
+        }
+        start = (long long)input.tellg();
+    }
+    return -1;
+}
+
+// Classifies the line [start, end) from window, which holds the file from windowStart on:
+// the block being searched plus the head of what follows it. Only a first token longer than
+// lineHeadBytes needs the whole line, from the file.
+template <typename Dialect>
+static LineKind classifyLineInWindow (ifstream & input, vector <char> const& window,
+    long long const& windowStart, long long const& start, long long const& end, bool const& trees,
+    string & head)
+{
+    long long length = end - start;
+    head.assign(window.data() + (start - windowStart),
+        length < (long long)lineHeadBytes ? length : (long long)lineHeadBytes);
+    if ((long long)head.size() < length && skipToken(head, skipWhiteSpace(head, 0)) == head.size()) {
+        head.assign(length, '\0');
+        input.clear();
+        input.seekg(start);
+        input.read(&head[0], length);
+    }
+    return classifyLineAs<Dialect>(head, trees);
+}
+
+// Reads backward from the end of the file, a block at a time, until 'last' sample lines
+// have been seen (or the data start is reached). Returns the offset of the earliest of them.
+template <typename Dialect>
+static long long findTailStartAs (ifstream & input, bool const& trees, long long const& dataStart,
+    long long const& fileSize, int const& last, int & found)
+{
+    vector <char> window(tailBlockBytes + lineHeadBytes);
+    string carried; // head of the block read before (i.e. the one after this)
+    string head;
+    long long tailStart = fileSize;
+    long long lineEnd = fileSize; // end of the line whose start is being sought
+    long long pos = fileSize;
+    long long blockStart = fileSize;
+    found = 0;
+
+    while (pos > dataStart && found < last) {
+        blockStart = (pos - dataStart > tailBlockBytes) ? pos - tailBlockBytes : dataStart;
+        long long blockBytes = pos - blockStart;
+        input.clear();
+        input.seekg(blockStart);
+        input.read(&window[0], blockBytes);
+        memcpy(&window[blockBytes], carried.data(), carried.size());
+        for (long long i = pos - 1; i >= blockStart && found < last; i--) {
+            if (window[i - blockStart] != '\n') {
+                continue;
+            }
+            if (classifyLineInWindow<Dialect>(input, window, blockStart, i + 1, lineEnd, trees, head) == LINE_SAMPLE) {
+                found++;
+                tailStart = i + 1;
+            }
+            lineEnd = i;
+        }
+        carried.assign(&window[0], blockBytes < (long long)lineHeadBytes ? blockBytes : (long long)lineHeadBytes);
+        pos = blockStart;
+    }
+// the line at dataStart has no newline before it within the data
+    if (found < last && pos == dataStart && lineEnd > dataStart) {
+        if (classifyLineInWindow<Dialect>(input, window, blockStart, dataStart, lineEnd, trees, head) == LINE_SAMPLE) {
+            found++;
+            tailStart = dataStart;
+        }
+    }
+    return tailStart;
+}
+
+template <typename Dialect>
+static long long locateTailAs (ifstream & input, bool const& trees, ostream * header,
+    long long const& fileSize, int const& last, int & found)
+{
+    found = 0;
+    long long dataStart = findDataStartAs<Dialect>(input, trees, header);
+    if (dataStart < 0) {
+        return fileSize;
+    }
+    return findTailStartAs<Dialect>(input, trees, dataStart, fileSize, last, found);
+}
+
+static long long locateTail (LogFormat const& format, ifstream & input, bool const& trees,
+    ostream * header, long long const& fileSize, int const& last, int & found)
+{
+    return withDialect(format, [&](auto dialect) {
+        return locateTailAs<decltype(dialect)>(input, trees, header, fileSize, last, found);
+    });
+}
+
+static string tailFileName (string const& fileName, int const& thinning, int const& last,
+    int const& nruns, string const& outputSuffix)
+{
+    string prefix = fileName; // only prefix passed in for multiple runs
+    if (nruns == 1) {
+        bool suffixEncountered = false;
+        prefix = removeStringSuffix(fileName, '.', suffixEncountered);
+    }
+    return prefix + "_thinned-" + convertIntToString(thinning) + "_last-" + convertIntToString(last)
+        + "." + outputSuffix;
+}
+
+void collectLastSamples (string const& fileName, string const& type, int const& nruns,
+    string & suffix, int const& last, int const& thinning, bool & overwrite,
+    string const& outputName)
+{
+    ofstream thinnedSamples;
+    bool trees = (type == "tree");
+    string sampleName = trees ? "trees" : "samples";
+
+    int totalFound = 0;
+    int totalSamples = 0;
+
+    if (suffix.empty()) {
+        suffix = resolveDefaultSuffix(fileName, nruns, type);
+    }
+
+    string tempFileName = outputName.empty()
+        ? tailFileName(fileName, thinning, last, nruns, trees ? "trees" : suffix) : outputName;
+    bool toStandardOutput = isStandardStream(tempFileName);
+
+    if (!overwrite && !toStandardOutput) {
+        // Check if file exists/is writable
+        bool validFileName = false;
+        while (!validFileName) {
+            validFileName = checkValidOutputFile(tempFileName);
+        }
+    }
+    if (!toStandardOutput) {
+        thinnedSamples.open(tempFileName.c_str());
+    }
+    ostream output(toStandardOutput ? standardOutputBuffer() : thinnedSamples.rdbuf());
+    LogFormat outputFormat = FORMAT_MRBAYES;
+
+    cout << endl
+    << "READING IN THE LAST " << last << " SAMPLES..." << endl << endl;
+
+    for (int i = 0; i < nruns; i++) {
+        string currentFile = runFileName(fileName, nruns, i, suffix);
+
+        checkValidInputFile(currentFile);
+        LogFormat format = detectLogFormat(currentFile, type);
+        if (i == 0) {
+            outputFormat = format;
+        }
+        ifstream input(currentFile.c_str(), ios::binary | ios::ate);
+        long long fileSize = (long long)input.tellg();
+
+        cout << "Extracting the last (" << last << ") samples from file '" << currentFile << "' ("
+            << logFormatName(format) << " format)." << endl;
+        cout << "Retaining every (" << thinning << ") " << sampleName << "..." << endl;
+
+    // header (comments, translate table, column names) only kept from the first file
+        int found = 0;
+        long long tailStart = locateTail(format, input, trees, (i == 0) ? &output : NULL,
+            fileSize, last, found);
+        if (found < last) {
+            cout << "File holds only " << found << " samples." << endl;
+        }
+
+        int sampleIndex = 0;
+        int sampleCounter = 0;
+        input.clear();
+        input.seekg(tailStart);
+        if (trees) {
+            thinTreeStream(format, input, output, false, NAMES_NUMERIC, thinning, 0,
+                sampleIndex, sampleCounter, totalSamples);
+        } else {
+            thinParameterStream(format, input, output, false, valuesAsWritten, thinning, 0,
+                sampleIndex, sampleCounter, totalSamples);
+        }
+        totalFound += found;
+        cout << "Retained " << sampleCounter << " samples." << endl << endl;
+    }
+    if (trees && nexusTreeFormat(outputFormat)) {
+        output << "End;" << endl;
+    }
+    output.flush();
+    thinnedSamples.close();
+
+    if (toStandardOutput) {
+        cout << endl << "Wrote " << totalSamples << " " << sampleName << " (from the last " << totalFound
+            << " samples) to standard output." << endl;
+    } else {
+        cout << endl << "Successfully created file '" << tempFileName << "', populated with "
+            << totalSamples << " " << sampleName << " (from the last " << totalFound << " samples)." << endl;
+    }
+}
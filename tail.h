@@ -0,0 +1,18 @@
+#ifndef _TAIL_H_
+#define _TAIL_H_
+
+#include <string>
+
+using namespace std;
+
+// Tail extraction ('-last N'): the header (everything before the first sample, e.g. the
+// translate table) is read from the start of each file, and the last N samples are found
+// by reading backward from the end in large blocks. Only the header and the kept samples
+// are read, however long the chain. The N samples are then thinned (every nth, starting
+// with the first of them) and renumbered exactly as in ordinary thinning.
+
+void collectLastSamples (string const& fileName, string const& type, int const& nruns,
+    string & suffix, int const& last, int const& thinning, bool & overwrite,
+    string const& outputName);
+
+#endif /* _TAIL_H_ */
@@ -0,0 +1,150 @@
+
+#include <iostream>
+#include <stdlib.h>
+
+using namespace std;
+
+#include "translate.h"
+#include "logformat.h"
+
+TranslateTable::TranslateTable ()
+    : reading_(false), pendingTaxon_(-1)
+{
+}
+
+int TranslateTable::size () const {
+    int numNames = 0;
+    for (size_t i = 0; i < names_.size(); i++) {
+        if (!names_[i].empty()) {
+            numNames++;
+        }
+    }
+    return numNames;
+}
+
+// Returns true if the line belongs to the translate command (which may be spread over any
+// number of lines, and have several 'number name' pairs per line), storing each pair.
+bool TranslateTable::parseLine (string const& line) {
+    size_t pos = skipWhiteSpace(line, 0);
+    size_t len = line.size();
+    if (!reading_) {
+        size_t end = skipToken(line, pos);
+        if (!tokenMatches(line, pos, end, "translate")) {
+            return false;
+        }
+        reading_ = true;
+        pos = end;
+    }
+    while (pos < len) {
+        char c = line[pos];
+        if (isSpaceChar(c) || c == ',') {
+            pos++;
+            continue;
+        }
+        if (c == ';') {
+            reading_ = false;
+            pendingTaxon_ = -1;
+            break;
+        }
+        size_t start = pos;
+        if (c == '\'') { // quoted name; '' is an escaped quote
+            pos++;
+            while (pos < len) {
+                if (line[pos] == '\'') {
+                    if (pos + 1 < len && line[pos + 1] == '\'') {
+                        pos += 2;
+                        continue;
+                    }
+                    pos++;
+                    break;
+                }
+                pos++;
+            }
+        } else {
+            while (pos < len && !isSpaceChar(line[pos]) && line[pos] != ',' && line[pos] != ';') {
+                pos++;
+            }
+        }
+        if (pendingTaxon_ < 0) {
+            pendingTaxon_ = atol(line.substr(start, pos - start).c_str());
+        } else {
+            if (pendingTaxon_ >= (long)names_.size()) {
+                names_.resize(pendingTaxon_ + 1);
+            }
+            names_[pendingTaxon_] = line.substr(start, pos - start);
+            pendingTaxon_ = -1;
+        }
+    }
+    return true;
+}
+
+TreeNameMode parseTreeNameMode (string const& mode) {
+    if (mode == "nexus") {
+        return NAMES_NEXUS;
+    } else if (mode == "newick") {
+        return NAMES_NEWICK;
+    }
+    cerr << "Error: unknown taxon name output '" << mode << "' (expecting 'nexus' or 'newick'). Exiting." << endl;
+    exit(1);
+}
+
+static bool endsTaxonLabel (char c) {
+    return c == ':' || c == ',' || c == ')' || c == ';' || c == '[' || isSpaceChar(c);
+}
+
+// Copies a (relabelled) tree line, replacing numeric taxon labels with names. A taxon label is
+// a run of digits directly after '(' or ','; branch lengths (after ':'), internal node labels
+// (after ')'), [comments] and 'quoted labels' are never touched. For NAMES_NEWICK only the tree
+// itself is kept, from its first '(' onwards.
+void appendNamedTree (string & out, string const& line, TranslateTable const& translation,
+    TreeNameMode const& nameMode)
+{
+    size_t len = line.size();
+    size_t pos = 0;
+    char previous = '\0';
+
+    if (nameMode == NAMES_NEWICK) {
+        while (pos < len && line[pos] != '(') {
+            if (line[pos] == '[') {
+                pos = line.find(']', pos);
+                if (pos == string::npos) {
+                    return;
+                }
+            }
+            pos++;
+        }
+    }
+
+    while (pos < len) {
+        char c = line[pos];
+        if (c == '[' || c == '\'') {
+            size_t close = line.find(c == '[' ? ']' : '\'', pos + 1);
+            close = (close == string::npos) ? len : close + 1;
+            out.append(line, pos, close - pos);
+            pos = close;
+            previous = line[close - 1];
+            continue;
+        }
+        if ((previous == '(' || previous == ',') && c >= '0' && c <= '9') {
+            size_t end = pos;
+            long taxon = 0;
+            while (end < len && line[end] >= '0' && line[end] <= '9') {
+                if (taxon < (1L << 30)) {
+                    taxon = taxon * 10 + (line[end] - '0');
+                }
+                end++;
+            }
+            if ((end == len || endsTaxonLabel(line[end])) && taxon < (1L << 30) && translation.hasName((int)taxon)) {
+                out += translation.name((int)taxon);
+            } else {
+                out.append(line, pos, end - pos);
+            }
+            previous = line[end - 1];
+            pos = end;
+            continue;
+        }
+        out += c;
+        previous = c;
+        pos++;
+    }
+}
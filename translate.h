@@ -0,0 +1,38 @@
+#ifndef _TRANSLATE_H_
+#define _TRANSLATE_H_
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// How taxa are written in thinned trees
+enum TreeNameMode {
+    NAMES_NUMERIC, // as in the input (translate table + numeric labels)
+    NAMES_NEXUS,   // NEXUS trees block, taxon names substituted, no translate table
+    NAMES_NEWICK   // one plain newick tree per line, taxon names substituted
+};
+
+// NEXUS translate table, read incrementally as the header streams past.
+// Names are held densely by taxon number (translate tables number from 1).
+class TranslateTable {
+public:
+    TranslateTable ();
+    bool parseLine (string const& line);
+    bool empty () const { return names_.empty(); }
+    int size () const;
+    string const& name (int const& taxon) const { return names_[taxon]; }
+    bool hasName (int const& taxon) const {
+        return taxon >= 0 && taxon < (int)names_.size() && !names_[taxon].empty();
+    }
+private:
+    vector <string> names_;
+    bool reading_;
+    long pendingTaxon_;
+};
+
+TreeNameMode parseTreeNameMode (string const& mode);
+void appendNamedTree (string & out, string const& line, TranslateTable const& translation,
+    TreeNameMode const& nameMode);
+
+#endif /* _TRANSLATE_H_ */
@@ -3,10 +3,16 @@
 #include <fstream>
 #include <vector>
 #include <sstream>
+#include <limits>
 
 using namespace std;
 
 #include "translog.h"
+#include "options.h"
+#include "logformat.h"
+#include "logstream.h"
+#include "numericlog.h"
+#include "treebinary.h"
 
 // version information
 double version = 0.41;
@@ -26,15 +32,13 @@ void printProgramInfo() {
     "************************************************" << endl << endl;
 }
 
-void processCommandLineArguments(int argc, char *argv[], string & fileName, int & thinning,
-    int & burnin, string & type, int & nruns, string & suffix, bool & count,
-    bool & overwrite)
+void processCommandLineArguments(int argc, char *argv[], ProgramOptions & options)
 {
     if (argc == 1) {
         cout << "Enter the name of the log file to be thinned: ";
-        cin >> fileName;
+        cin >> options.fileName;
         cout << "Enter the thinning value 'n' (where every nth sample will be retained): ";
-        cin >> thinning;
+        cin >> options.thinning;
     } else {
         for (int i = 1; i < argc; i++) {
             string temp = argv[i];
@@ -51,35 +55,97 @@ void processCommandLineArguments(int argc, char *argv[], string & fileName, int
                 exit(0);  
             } else if (temp == "-t") {
                 i++;
-                fileName = argv[i];
-                type = "tree";
+                options.fileName = argv[i];
+                options.type = "tree";
                 continue;
             } else if (temp == "-p") {
                 i++;
-                fileName = argv[i];
-                type = "parameter";
+                options.fileName = argv[i];
+                options.type = "parameter";
                 continue;
             } else if (temp == "-n") {
                 i++;
-                thinning = convertStringtoInt(argv[i]);
+                options.thinning = convertStringtoInt(argv[i]);
                 continue;
             } else if (temp == "-b") {
                 i++;
-                burnin = convertStringtoInt(argv[i]);
+                options.burnin = convertStringtoInt(argv[i]);
                 continue;
             } else if (temp == "-r") {
                 i++;
-                nruns = convertStringtoInt(argv[i]);
+                options.nruns = convertStringtoInt(argv[i]);
                 continue;
             } else if (temp == "-s") {
                 i++;
-                suffix = argv[i];
+                options.suffix = argv[i];
+                continue;
+            } else if (temp == "-last" || temp == "--last") {
+                i++;
+                options.last = convertStringtoInt(argv[i]);
+                continue;
+            } else if (temp == "-serve") {
+                i++;
+                options.server.serveSocket = argv[i];
+                continue;
+            } else if (temp == "-client") {
+                i++;
+                options.server.clientSocket = argv[i];
+                continue;
+            } else if (temp == "-stop") {
+                options.server.stop = true;
+                continue;
+            } else if (temp == "-slice") {
+                i++;
+                options.server.sliceFirst = convertStringtoInt(argv[i]);
+                i++;
+                options.server.sliceCount = convertStringtoInt(argv[i]);
+                continue;
+            } else if (temp == "-digits" || temp == "-fixed") {
+                i++;
+                options.numeric.enabled = true;
+                options.numeric.fixed = (temp == "-fixed");
+                options.numeric.precision = parsePrecision(argv[i], options.numeric.fixed ? 30 : 17);
+                continue;
+            } else if (temp == "-csv") {
+                options.numeric.enabled = true;
+                options.numeric.delimiter = ',';
+                continue;
+            } else if (temp == "-o") {
+                i++;
+                options.outputName = argv[i];
                 continue;
             } else if (temp == "-count") {
-                count = true;
+                options.count = true;
                 continue;
             } else if (temp == "-overwrite") {
-                overwrite = true;
+                options.overwrite = true;
+                continue;
+            } else if (temp == "-binary") {
+                i++;
+                options.binary.enabled = true;
+                options.binary.encoding = parseBranchLengthEncoding(argv[i], options.binary.decimals);
+                continue;
+            } else if (temp == "-decode") {
+                options.decode = true;
+                continue;
+            } else if (temp == "-asdsf") {
+                options.asdsf = true;
+                continue;
+            } else if (temp == "-names") {
+                i++;
+                options.nameMode = parseTreeNameMode(argv[i]);
+                continue;
+            } else if (temp == "-shardcount" || temp == "-shard") {
+                options.shardMode = (temp == "-shard") ? "thin" : "count";
+                i++;
+                options.shard = convertStringtoInt(argv[i]);
+                i++;
+                options.nshards = convertStringtoInt(argv[i]);
+                continue;
+            } else if (temp == "-merge") {
+                options.shardMode = "merge";
+                i++;
+                options.nshards = convertStringtoInt(argv[i]);
                 continue;
             } else {
                 cout
@@ -95,7 +161,9 @@ void processCommandLineArguments(int argc, char *argv[], string & fileName, int
 }
 
 void printProgramUsage () {
-    cout << "./Translogrifier [-t treefile] or [-p parameterfile] [-n thinning] [-b burnin] [-r num_runs] [-s suffix] [-count] [-overwrite] [-h]" << endl
+    cout << "./Translogrifier [-t treefile] or [-p parameterfile] [-n thinning] [-b burnin] [-r num_runs] [-s suffix] [-count] [-asdsf] [-overwrite] [-names nexus|newick]" << endl
+    << "    [-binary float|decimals] [-decode] [-o outfile] [--last N] [-digits d | -fixed d] [-csv]" << endl
+    << "    [-shardcount k K] [-shard k K] [-merge K] [-serve socket] [-client socket [-slice first num] [-stop]] [-h]" << endl
     << endl
     << "where" << endl
     << endl
@@ -107,54 +175,178 @@ void printProgramUsage () {
     << "   e.g. for 'foo.run1.p' provide 'foo'" << endl
     << " - PLEASE NOTE: if combining multiple tree files, program assumes identical translation tables in each." << endl
     << "'suffix' is an abnormal file suffix i.e. NOT '.p' (for parameters) or '.t' (for trees)." << endl
+    << " - a treefile or parameterfile of '-' reads a single log from standard input." << endl
     << "'-count' specifies that samples are simply counted (possibly across files)." << endl
+    << "'--last N' keeps only the final N samples of each file (then thinned with '-n'), reading backward" << endl
+    << "   from the end so that the rest of the file is never read. Replaces '-b'." << endl
+    << "'-asdsf' reports the average standard deviation of split frequencies across (post-burnin) tree runs," << endl
+    << "   and the splits on which the runs disagree most. Requires '-r' with at least 2 runs." << endl
     << "'-overwrite' will overwrite files without a warning message." << endl
+    << "'-o' names the output file instead of 'prefix_thinned-n_burnin-b.suffix'; '-' writes samples to" << endl
+    << "   standard output (the default when reading standard input), with messages on standard error." << endl
+    << "   Also applies to '-decode' and '-merge'; not to '-shard', '-shardcount', '-count' or '-asdsf'." << endl
+    << "'-names' replaces translate-table numbers in trees with taxon names, writing either a NEXUS" << endl
+    << "   trees block without a translate table ('nexus') or one newick tree per line ('newick')." << endl
+    << "'-binary' writes thinned trees to a compact, randomly accessible '.tbin' file; branch lengths" << endl
+    << "   are stored as float32 ('float', not exact) or exactly, with the given number of decimal places (e.g. 6)." << endl
+    << "'-decode' converts a '.tbin' file (given with '-t') back to NEXUS, applying any burnin/thinning." << endl
+    << "'-digits d' re-writes parameter values with d significant digits, '-fixed d' with d decimal places;" << endl
+    << "   integer columns are left as they are. '-csv' writes comma-separated values (to a '.csv' file)." << endl
+    << "   With any of these, every row must have as many columns as the header." << endl
+    << "'-shardcount k K', '-shard k K' and '-merge K' split thinning across K processes (e.g. cluster nodes)." << endl
+    << " - each process k (1..K) runs '-shardcount k K' (only needed when there are fewer runs than shards)," << endl
+    << "   then '-shard k K'; a final '-merge K' writes the same file as a single process would." << endl
+    << "'-serve socket' runs a server on a local (Unix) socket that keeps an index of every log it is asked" << endl
+    << "   about, so repeated queries only read the samples they need; files are re-indexed when they change." << endl
+    << " - '-client socket' sends the count ('-count'), thinning or slice request to that server instead;" << endl
+    << "   '-slice first num' writes samples first..first+num-1 (0-based) as they appear in the file," << endl
+    << "   and '-stop' shuts the server down." << endl
     << "'-h' prints this help" << endl
     << endl
     << "*** NOTE *** All values are in terms of number of SAMPLES (NOT generations)." <<endl << endl
     << "*** NOTE *** All line returns are expected to be in unix format. This is not checked." << endl << endl;
 }
 
+// Only the start of each tree line is read up front (see lineHeadBytes); trees that are not
+// kept are then skipped rather than buffered
+// Reads the start of the next line into head; 'complete' if that was the whole line.
+// Returns false at end of input, like getline.
+static bool readLineHead (istream & input, string & head, bool & complete) {
+    streambuf * buffer = input.rdbuf();
+    head.clear();
+    complete = true;
+    while (head.size() < lineHeadBytes) {
+        int c = buffer->sbumpc();
+        if (c == char_traits<char>::eof()) {
+            if (head.empty()) {
+                input.setstate(ios::eofbit | ios::failbit);
+                return false;
+            }
+            return true;
+        }
+        if (c == '\n') {
+            return true;
+        }
+        head += char(c);
+    }
+    int c = buffer->sgetc();
+    if (c == '\n') {
+        buffer->sbumpc();
+    } else if (c != char_traits<char>::eof()) {
+        complete = false;
+    }
+    return true;
+}
+
+// Appends the remainder of a partially read line
+static void finishLine (istream & input, string & head, string & rest, bool & complete) {
+    if (!complete) {
+        getline(input, rest);
+        head += rest;
+        complete = true;
+    }
+}
+
+static void skipLine (istream & input, bool & complete) {
+    if (!complete) {
+        input.ignore(numeric_limits<streamsize>::max(), '\n');
+        complete = true;
+    }
+}
+
+// Reads the head of the next tree line, making sure it holds at least the complete first token
+static bool readTreeLineHead (istream & input, string & head, string & rest, bool & complete) {
+    if (!readLineHead(input, head, complete)) {
+        return false;
+    }
+    if (!complete && skipToken(head, skipWhiteSpace(head, 0)) == head.size()) {
+        finishLine(input, head, rest, complete);
+    }
+    return true;
+}
+
+template <typename Dialect>
+static int countTreeStreamAs (istream & treeInput) {
+    int treeCounter = 0;
+    string line;
+    string rest;
+    bool complete = true;
+    while (readTreeLineHead(treeInput, line, rest, complete)) {
+        if (classifyTreeLine<Dialect>(line) == LINE_SAMPLE) {
+            treeCounter++;
+        }
+        skipLine(treeInput, complete);
+    }
+    return treeCounter;
+}
+
+int countTreeStream (LogFormat const& format, istream & treeInput) {
+    return withDialect(format, [&](auto dialect) {
+        return countTreeStreamAs<decltype(dialect)>(treeInput);
+    });
+}
+
+// the first non-empty, non-commented-out line is taken to be the header
+template <typename Dialect>
+static int countParameterStreamAs (istream & parameterInput, vector <string> & header) {
+    int parameterCounter = 0;
+    string line;
+    bool firstLine = true;
+    while (getline(parameterInput, line)) {
+        LineKind kind = classifyParameterLine<Dialect>(line);
+        if (kind == LINE_BLANK || kind == LINE_COMMENT) {
+            continue;
+        } else if (firstLine) {
+            header = tokenize(line);
+            firstLine = false;
+        } else {
+            parameterCounter++;
+        }
+    }
+    return parameterCounter;
+}
+
+int countParameterStream (LogFormat const& format, istream & parameterInput, vector <string> & header) {
+    return withDialect(format, [&](auto dialect) {
+        return countParameterStreamAs<decltype(dialect)>(parameterInput, header);
+    });
+}
+
+// every row that is not a comment or the header; unlike countParameterStream this makes no
+// assumption that the stream starts at the top of a file
+template <typename Dialect>
+static int countParameterRowsAs (istream & parameterInput) {
+    int parameterCounter = 0;
+    string line;
+    while (getline(parameterInput, line)) {
+        if (classifyParameterLine<Dialect>(line) == LINE_SAMPLE) {
+            parameterCounter++;
+        }
+    }
+    return parameterCounter;
+}
+
+int countParameterRows (LogFormat const& format, istream & parameterInput) {
+    return withDialect(format, [&](auto dialect) {
+        return countParameterRowsAs<decltype(dialect)>(parameterInput);
+    });
+}
+
 void countTreeSamples (string const& fileName, int const& nruns, string & suffix) {
     int totalTrees = 0;
-    bool commentLine = false;
-    bool whiteSpaceOnly = false;
     
     if (suffix.empty()) {
-        suffix = "t";
+        suffix = resolveDefaultSuffix(fileName, nruns, "tree");
     }
     
     cout << "READING IN AND COUNTING TREE SAMPLES..." << endl << endl;
     
     for (int i = 0; i < nruns; i++) {
-        ifstream treeInput;
-        string currentFile = fileName;
-        if (nruns > 1) {
-// use MrBayes naming convention
-            string runNumber = convertIntToString((i +1));
-            currentFile = currentFile + ".run" + runNumber + "." + suffix;
-        }
-        
-        checkValidInputFile(currentFile);
-        treeInput.open(currentFile.c_str());
-        int treeCounter = 0;        // Total samples in current file
-        string line;
+        string currentFile = runFileName(fileName, nruns, i, suffix);
+        LogInput treeInput(currentFile, "tree");
         
     // Read in every non-empty (or non-whitespace), non-commented-out line
-        while (getline(treeInput,line)) {
-            int stringPosition = 0;
-            string temp;
-            commentLine = checkCommentLine(line);
-            whiteSpaceOnly = checkWhiteSpaceOnly(line);
-            if (line.empty() || commentLine || whiteSpaceOnly) { // header
-                continue;
-            } else {
-                if (checkStringValue(line, "tree", stringPosition)) {
-                    treeCounter++;
-                }
-            }
-        }
-        treeInput.close();
+        int treeCounter = countTreeStream(treeInput.format(), treeInput.stream()); // Total samples in current file
         if (nruns > 1) {
             cout << "Read " << treeCounter << " samples from file " << i+1 << " of " << nruns << "." << endl << endl;
         }
@@ -167,70 +359,40 @@ void countTreeSamples (string const& fileName, int const& nruns, string & suffix
 void countParameterSamples (string const& fileName, int const& nruns, string & suffix) {
     int numSamples = 0;
     int numPars = 0;
-    bool commentLine = false;
-    bool whiteSpaceOnly = false;
     vector <string> colnames;
     
     if (suffix.empty()) {
-        suffix = "p";
+        suffix = resolveDefaultSuffix(fileName, nruns, "parameter");
     }
     
     cout << "READING IN AND COUNTING PARAMETER SAMPLES..." << endl << endl;
     
     for (int i = 0; i < nruns; i++) {
-        ifstream parameterInput;
-        string currentFile = fileName;
-        if (nruns > 1) {
-// use MrBayes naming convention
-            string runNumber = convertIntToString((i +1));
-            currentFile = currentFile + ".run" + runNumber + "." + suffix;
-        }
-        
-        checkValidInputFile(currentFile);
-        parameterInput.open(currentFile.c_str());
-        
-        int parameterCounter = 0;
-        string line;
-        bool firstLine = true;
+        string currentFile = runFileName(fileName, nruns, i, suffix);
+        LogInput parameterInput(currentFile, "parameter");
         
     // Read in every non-empty (or non-whitespace), non-commented-out line
-        while (getline(parameterInput, line)) {
-            //int stringPosition = 0;
-            //string temp;
-            
-            commentLine = checkCommentLine(line);
-            whiteSpaceOnly = checkWhiteSpaceOnly(line);
-            if (line.empty() || commentLine || whiteSpaceOnly) {
-                continue;
-            //} else if (checkStringValue(line, "Gen", stringPosition) || checkStringValue(line, "state", stringPosition)) { // MrBayes or BEAST
-            } else if (firstLine) {
-                vector <string> header = tokenize(line);
-                int curpars = header.size();
-                if (i == 0) {
-                    numPars = curpars;
-                    colnames = header;
-                } else {
-                    // check that we've still got the same number of parameters i.e. files match
-                    if (curpars != numPars) {
-                        cout << "Error: number of parameters in file " << (i + 1)
-                            << "(" << curpars << ") does not match that from file 1 ("
-                            << numPars << "). Exiting." << endl;
-                        exit(0);
-                    } else if (header != colnames) {
-                        // check that the headers match (not just in length)
-                        cout << "Error: header for file " << (i + 1)
-                            << "does not match that from file 1. Exiting." << endl;
-                        exit(0);
-                    }  
-                }
-                firstLine = false;
-                continue;
-            } else {
-                parameterCounter++;
-                continue;
-            }
+        vector <string> header;
+        int parameterCounter = countParameterStream(parameterInput.format(), parameterInput.stream(), header);
+        
+        int curpars = header.size();
+        if (i == 0) {
+            numPars = curpars;
+            colnames = header;
+        } else {
+            // check that we've still got the same number of parameters i.e. files match
+            if (curpars != numPars) {
+                cout << "Error: number of parameters in file " << (i + 1)
+                    << "(" << curpars << ") does not match that from file 1 ("
+                    << numPars << "). Exiting." << endl;
+                exit(0);
+            } else if (header != colnames) {
+                // check that the headers match (not just in length)
+                cout << "Error: header for file " << (i + 1)
+                    << "does not match that from file 1. Exiting." << endl;
+                exit(0);
+            }  
         }
-        parameterInput.close();
         if (nruns > 1) {
             cout << "Read " << parameterCounter << " samples (with " << numPars 
                 << " columns) from file " << (i + 1) << " of " << nruns << "." << endl << endl;
@@ -253,20 +415,24 @@ vector <string> tokenize (string const& input) {
     return tokens;
 }
 
+void reportInputFileFailure (string const& fileName) {
+    ofstream errorReport("Error.Translogrifier.txt");
+    errorReport << "Translogrifier analysis failed." << endl << "Error: unable to open file '";
+    errorReport << fileName << "'" << endl;
+    errorReport.close();
+    
+    cerr << endl << "Translogrifier analysis failed. " << endl << "Error: unable to open file '";
+    cerr << fileName << "'" <<  endl;
+    exit(1);
+}
+
 bool checkValidInputFile (string fileName) {
     bool validInput = false;
     ifstream tempStream;
     
     tempStream.open(fileName.c_str());
     if (tempStream.fail()) {
-        ofstream errorReport("Error.Translogrifier.txt");
-        errorReport << "Translogrifier analysis failed." << endl << "Error: unable to open file '";
-        errorReport << fileName << "'" << endl;
-        errorReport.close();
-        
-        cerr << endl << "Translogrifier analysis failed. " << endl << "Error: unable to open file '";
-        cerr << fileName << "'" <<  endl;
-        exit(1);
+        reportInputFileFailure(fileName);
     } else {
         cout << "Successfully opened file '" << fileName << "'." <<  endl << endl;
         validInput = true;
@@ -426,6 +592,26 @@ string removeStringPrefix(string stringToParse, char characterToRemove) {
     return tempString;
 }
 
+// use MrBayes naming convention for replicated runs: prefix.runx.suffix (run is 0-based)
+string runFileName (string const& fileName, int const& nruns, int const& run, string const& suffix) {
+    if (nruns == 1) {
+        return fileName;
+    }
+    return fileName + ".run" + convertIntToString(run + 1) + "." + suffix;
+}
+
+string thinnedFileName (string const& fileName, int const& thinning, int const& burnin, int const& nruns,
+    string const& outputSuffix)
+{
+    string prefix = fileName; // only prefix passed in for multiple runs
+    if (nruns == 1) {
+        bool suffixEncountered = false;
+        prefix = removeStringSuffix(fileName, '.', suffixEncountered);
+    }
+    return prefix + "_thinned-" + convertIntToString(thinning) + "_burnin-" + convertIntToString(burnin)
+        + "." + outputSuffix;
+}
+
 bool checkValidOutputFile (string & outputFileName) {
     bool testOutBool = true;
     bool fileNameAcceptable = false;
@@ -472,30 +658,159 @@ bool checkValidOutputFile (string & outputFileName) {
     return testOutBool;
 }
 
+// Samples are indexed from 0 within each file; the first retained sample is the one
+// immediately following the burnin, then every 'thinning'th sample after that
+bool retainSample (int const& sampleIndex, int const& burnin, int const& thinning) {
+    int offset = sampleIndex - burnin;
+    if (offset < 0) {
+        return false;
+    }
+    return offset == 0 || (thinning > 0 && offset % thinning == 0);
+}
+
+// Thins a single tree log. If keepHeader, comments and everything preceding the first
+// tree (e.g. translation table) is passed through; nothing after the trees is kept.
+// treeCounter is the index of the first tree in the stream (non-zero when starting mid-file).
+// Unless nameMode is NAMES_NUMERIC, the translate table is read (not written) and taxon
+// numbers in retained trees are replaced by names; NAMES_NEWICK writes bare trees only.
+template <typename Dialect>
+static void thinTreeStreamAs (istream & treeInput, ostream & thinnedTrees, bool const& keepHeader,
+    TreeNameMode const& nameMode, int const& thinning, int const& burnin, int & treeCounter,
+    int & sampleCounter, int & totalSamples)
+{
+    string line;
+    string rest;
+    string outLine;
+    string namedLine;
+    bool complete = true;
+    bool treesEncountered = (treeCounter > 0);
+    bool expandNames = (nameMode != NAMES_NUMERIC);
+    bool writeHeader = keepHeader && nameMode != NAMES_NEWICK;
+    TranslateTable translation;
+    
+    while (readTreeLineHead(treeInput, line, rest, complete)) {
+        LineKind kind = classifyTreeLine<Dialect>(line);
+        if (kind == LINE_SAMPLE) {
+            treesEncountered = true;
+            if (retainSample(treeCounter, burnin, thinning)) {
+                finishLine(treeInput, line, rest, complete);
+                outLine.clear();
+                relabelTreeLine<Dialect>(outLine, line, totalSamples);
+                if (expandNames) {
+                    namedLine.clear();
+                    appendNamedTree(namedLine, outLine, translation, nameMode);
+                    outLine.swap(namedLine);
+                }
+                outLine += '\n';
+                thinnedTrees.write(outLine.data(), outLine.size());
+                sampleCounter++;
+                totalSamples++;
+            }
+            skipLine(treeInput, complete);
+            treeCounter++;
+            continue;
+        }
+        finishLine(treeInput, line, rest, complete);
+        if (expandNames && kind == LINE_OTHER && !treesEncountered && translation.parseLine(line)) {
+            continue;
+        } else if (writeHeader && (kind == LINE_BLANK || kind == LINE_COMMENT || !treesEncountered)) {
+            thinnedTrees << line << '\n';
+        }
+    }
+}
+
+void thinTreeStream (LogFormat const& format, istream & treeInput, ostream & thinnedTrees,
+    bool const& keepHeader, TreeNameMode const& nameMode, int const& thinning, int const& burnin,
+    int & treeCounter, int & sampleCounter, int & totalSamples)
+{
+    withDialect(format, [&](auto dialect) {
+        thinTreeStreamAs<decltype(dialect)>(treeInput, thinnedTrees, keepHeader, nameMode, thinning,
+            burnin, treeCounter, sampleCounter, totalSamples);
+    });
+}
+
+// Thins a single parameter log. If keepHeader, comments (except in CSV) and the column header are passed through.
+// With numeric output, values are re-emitted as requested and every row (kept or not) must have
+// as many columns as the header.
+template <typename Dialect>
+static void thinParameterStreamAs (istream & parameterInput, ostream & thinnedParameters,
+    bool const& keepHeader, NumericOutputOptions const& numeric, int const& thinning, int const& burnin,
+    int & parameterCounter, int & sampleCounter, int & totalSamples)
+{
+    string line;
+    string outLine;
+    size_t columns = 0; // from the header; unknown when starting mid-file
+    
+    while (getline(parameterInput, line)) {
+        LineKind kind = classifyParameterLine<Dialect>(line);
+        if (kind != LINE_SAMPLE) {
+            if (numeric.enabled && kind == LINE_HEADER) {
+                outLine.clear();
+                columns = appendDelimitedTokens(outLine, line, 0, numeric.delimiter);
+                line.swap(outLine);
+            }
+        // CSV is only the header and rows: readers would take a leading comment for the header
+            if (keepHeader && (kind == LINE_HEADER || numeric.delimiter != ',')) {
+                thinnedParameters << line << '\n';
+            }
+            continue;
+        }
+        bool retain = retainSample(parameterCounter, burnin, thinning);
+        if (numeric.enabled) {
+            outLine.clear();
+            size_t rowColumns = retain ? appendNumericRow(outLine, line, totalSamples, numeric) : countColumns(line);
+            if (columns != 0 && rowColumns != columns) {
+                cerr << "Error: sample " << parameterCounter << " has " << rowColumns
+                    << " columns, but the header has " << columns << ". Exiting." << endl;
+                exit(1);
+            }
+        }
+        if (retain) {
+            if (!numeric.enabled) {
+                outLine.clear();
+                relabelParameterLine(outLine, line, totalSamples);
+            }
+            outLine += '\n';
+            thinnedParameters.write(outLine.data(), outLine.size());
+            sampleCounter++;
+            totalSamples++;
+        }
+        parameterCounter++;
+    }
+}
+
+void thinParameterStream (LogFormat const& format, istream & parameterInput, ostream & thinnedParameters,
+    bool const& keepHeader, NumericOutputOptions const& numeric, int const& thinning, int const& burnin,
+    int & parameterCounter, int & sampleCounter, int & totalSamples)
+{
+    withDialect(format, [&](auto dialect) {
+        thinParameterStreamAs<decltype(dialect)>(parameterInput, thinnedParameters, keepHeader,
+            numeric, thinning, burnin, parameterCounter, sampleCounter, totalSamples);
+    });
+}
+
 void collectTreesAndThin (string const& fileName, int const& thinning, int const& burnin,
-    string & suffix, int const& nruns, bool & overwrite)
+    string & suffix, int const& nruns, bool & overwrite, TreeNameMode const& nameMode,
+    BinaryTreeOptions const& binary, string const& outputName)
 {
     ofstream thinnedTrees;
+    TreeBinaryWriter binaryWriter;
+    TreeBinaryLineBuffer binaryLines(binaryWriter);
     bool validFileName = false;
     string tempFileName;
     
     int totalTrees = 0;
     int totalSamples = 0;
     
-    if (nruns == 1) {
-        tempFileName = removeStringSuffix(fileName, '.', validFileName);
-    } else {
-// e.g. 'Archaeopteryx_gamma-rates_unequal-frequencies_temp-0.05.run1.p'
-        tempFileName = fileName; // only prefix passed in
-    }
-    
     if (suffix.empty()) {
-        suffix = "t";
+        suffix = resolveDefaultSuffix(fileName, nruns, "tree");
     }
     
-    tempFileName = tempFileName + "_thinned-" + convertIntToString(thinning) + "_burnin-" + convertIntToString(burnin) + ".trees";
+    tempFileName = outputName.empty() ? thinnedFileName(fileName, thinning, burnin, nruns,
+        binary.enabled ? "tbin" : (nameMode == NAMES_NEWICK) ? "tre" : "trees") : outputName;
+    bool toStandardOutput = isStandardStream(tempFileName);
     
-    if (!overwrite) {
+    if (!overwrite && !toStandardOutput) {
         // Check if file exists/is writable
         validFileName = false;
         while (!validFileName) {
@@ -503,26 +818,37 @@ void collectTreesAndThin (string const& fileName, int const& thinning, int const
         }
     }
     
-    thinnedTrees.open(tempFileName.c_str());
-    bool commentLine = false;
-    bool whiteSpaceOnly = false;
+    if (binary.enabled) {
+        if (!binaryWriter.open(tempFileName, binary.encoding, binary.decimals)) {
+            cerr << endl << "Translogrifier analysis failed." << endl << "Error: unable to open file '";
+            cerr << tempFileName << "'" <<  endl;
+            exit(1);
+        }
+    } else if (!toStandardOutput) {
+        thinnedTrees.open(tempFileName.c_str());
+    }
+// the binary writer is fed the same text that would otherwise go to file
+    ostream output(binary.enabled ? static_cast<streambuf *>(&binaryLines)
+        : toStandardOutput ? standardOutputBuffer() : thinnedTrees.rdbuf());
+    LogFormat outputFormat = FORMAT_MRBAYES;
 
     cout << endl
     << "READING IN AND THINNING TREES..." << endl << endl;
     
     for (int i = 0; i < nruns; i++) {
-        ifstream treeInput;
-        string currentFile = fileName;
-        if (nruns > 1) {
-// use MrBayes naming convention
-            string runNumber = convertIntToString((i +1));
-            currentFile = currentFile + ".run" + runNumber + "." + suffix;
+        string currentFile = runFileName(fileName, nruns, i, suffix);
+        LogInput treeInput(currentFile, "tree");
+        LogFormat format = treeInput.format();
+        if (i == 0) {
+            outputFormat = format;
+            if (binary.enabled && !nexusTreeFormat(format)) {
+                cerr << "Error: binary output requires NEXUS tree files. Exiting." << endl;
+                exit(1);
+            }
         }
         
-        checkValidInputFile(currentFile);
-        treeInput.open(currentFile.c_str());
-        
-        cout << "Extracting samples from file '" << currentFile << "'." << endl;
+        cout << "Extracting samples from file '" << currentFile << "' ("
+            << logFormatName(format) << " format)." << endl;
         
         if (burnin != 0) {
             cout << "Ignoring first (" << burnin << ") trees..." << endl;
@@ -533,70 +859,35 @@ void collectTreesAndThin (string const& fileName, int const& thinning, int const
         
         int treeCounter = 0;        // Total samples
         int sampleCounter = 0;        // Samples retained
-        string line;
-        bool treesEncountered = false;
         
     // Read in every non-empty (or non-whitespace), non-commented-out line
-        while (getline(treeInput,line)) {
-            int stringPosition = 0;
-            string temp;
-            commentLine = checkCommentLine(line);
-            whiteSpaceOnly = checkWhiteSpaceOnly(line);
-            if (line.empty() || commentLine || whiteSpaceOnly) {
-                if (i == 0) {
-                    thinnedTrees << line << endl;
-                }
-                continue;
-            } else {
-                if (checkStringValue(line, "tree", stringPosition)) { // tree line
-                    if (treeCounter == 0) treesEncountered = true;
-                    if ((treeCounter-burnin) > 0 && (treeCounter-burnin) < thinning) {
-                        treeCounter++;
-                        totalTrees++;
-                        continue;
-                    } else if ((treeCounter-burnin) == 0) {
-//    tree rep.1 = [something_maybe] ((((((((((((((4:0.3223,
-                        temp = removeStringElement(line, 0);
-                        temp = removeStringElement(temp, 0); // will this work, or delete just the tab?
-                        thinnedTrees << "tree STATE_" << totalSamples << temp << endl;
-                        treeCounter++;
-                        totalTrees++;
-                        sampleCounter++;
-                        totalSamples++;
-                        continue;
-                    } else if ((treeCounter-burnin) > 0 && (treeCounter-burnin) % thinning == 0) {
-                        temp = removeStringElement(line, 0);
-                        temp = removeStringElement(temp, 0); // will this work, or delete just the tab?
-                        thinnedTrees << "tree STATE_" << totalSamples << temp << endl;
-                        treeCounter++;
-                        totalTrees++;
-                        sampleCounter++;
-                        totalSamples++;
-                        continue;
-                    } else { // shouldn't get here
-                        treeCounter++;
-                        totalTrees++;
-                        continue;
-                    }
-                } else { // not a tree line. only care about first file here. don't want anything below trees
-                    if (i == 0 && !treesEncountered) { // keep header from first file
-                        thinnedTrees << line << endl;
-                    }
-                }
-            }
-        }
-        treeInput.close();
+        thinTreeStream(format, treeInput.stream(), output, (i == 0), nameMode, thinning, burnin,
+            treeCounter, sampleCounter, totalSamples);
+        totalTrees += treeCounter;
         cout << "Retained " << sampleCounter << " samples." << endl << endl;
     }
-    thinnedTrees << "End;" << endl;
-    thinnedTrees.close();
+    if (binary.enabled) {
+        binaryWriter.close();
+    } else {
+        if (nexusTreeFormat(outputFormat) && nameMode != NAMES_NEWICK) {
+            output << "End;" << endl;
+        }
+        output.flush();
+        thinnedTrees.close();
+    }
     
-    cout << endl << "Successfully created file '" << tempFileName << "', populated with " << totalSamples << " trees (from original " <<
-    totalTrees << " samples)." << endl;
+    if (toStandardOutput) {
+        cout << endl << "Wrote " << totalSamples << " trees (from original " << totalTrees
+            << " samples) to standard output." << endl;
+    } else {
+        cout << endl << "Successfully created file '" << tempFileName << "', populated with " << totalSamples << " trees (from original " <<
+        totalTrees << " samples)." << endl;
+    }
 }
 
 void collectParametersAndThin (string const& fileName, int const& thinning, int const& burnin,
-    int const& nruns, string & suffix, bool & overwrite)
+    int const& nruns, string & suffix, bool & overwrite, string const& outputName,
+    NumericOutputOptions const& numeric)
 {
     ofstream thinnedParameters;
     bool validFileName = false;
@@ -605,20 +896,15 @@ void collectParametersAndThin (string const& fileName, int const& thinning, int
     int totalParameters = 0;
     int totalSamples = 0;
     
-    if (nruns == 1) {
-        tempFileName = removeStringSuffix(fileName, '.', validFileName);
-    } else {
-// e.g. 'Archaeopteryx_gamma-rates_unequal-frequencies_temp-0.05.run1.p'
-        tempFileName = fileName; // only prefix passed in
-    }
-    
     if (suffix.empty()) {
-        suffix = "p";
+        suffix = resolveDefaultSuffix(fileName, nruns, "parameter");
     }
     
-    tempFileName = tempFileName + "_thinned-" + convertIntToString(thinning) + "_burnin-" + convertIntToString(burnin) + "." + suffix;
+    tempFileName = outputName.empty() ? thinnedFileName(fileName, thinning, burnin, nruns,
+        (numeric.delimiter == ',') ? "csv" : suffix) : outputName;
+    bool toStandardOutput = isStandardStream(tempFileName);
         
-    if (!overwrite) {
+    if (!overwrite && !toStandardOutput) {
         // Check if file exists/is writable
         validFileName = false;
         while (!validFileName) {
@@ -626,26 +912,21 @@ void collectParametersAndThin (string const& fileName, int const& thinning, int
         }
     }
     
-    thinnedParameters.open(tempFileName.c_str());
-    bool commentLine = false;
-    bool whiteSpaceOnly = false;
+    if (!toStandardOutput) {
+        thinnedParameters.open(tempFileName.c_str());
+    }
+    ostream output(toStandardOutput ? standardOutputBuffer() : thinnedParameters.rdbuf());
     
     cout << endl
     << "READING IN AND THINNING PARAMETERS..." << endl << endl;
     
     for (int i = 0; i < nruns; i++) {
-        ifstream parameterInput;
-        string currentFile = fileName;
-        if (nruns > 1) {
-// use MrBayes naming convention
-            string runNumber = convertIntToString((i +1));
-            currentFile = currentFile + ".run" + runNumber + "." + suffix;
-        }
-        
-        checkValidInputFile(currentFile);
-        parameterInput.open(currentFile.c_str());
+        string currentFile = runFileName(fileName, nruns, i, suffix);
+        LogInput parameterInput(currentFile, "parameter");
+        LogFormat format = parameterInput.format();
         
-        cout << "Extracting samples from file '" << currentFile << "'." << endl;
+        cout << "Extracting samples from file '" << currentFile << "' ("
+            << logFormatName(format) << " format)." << endl;
         
         if (burnin != 0) {
             cout << "Ignoring first (" << burnin << ") samples..." << endl;
@@ -656,61 +937,22 @@ void collectParametersAndThin (string const& fileName, int const& thinning, int
         
         int parameterCounter = 0;
         int sampleCounter = 0;
-        string line;
-        //bool headerEncountered = false;
         
     // Read in every non-empty (or non-whitespace), non-commented-out line
-        while (getline(parameterInput, line)) {
-            int stringPosition = 0;
-            string temp;
-            
-            commentLine = checkCommentLine(line);
-            whiteSpaceOnly = checkWhiteSpaceOnly(line);
-            if (line.empty() || commentLine || whiteSpaceOnly) {
-                // keep any comments from top of first file. don't really need this...
-                if (i == 0) {
-                    thinnedParameters << line << endl;
-                }
-                continue;
-            } else if (checkStringValue(line, "Gen", stringPosition) || checkStringValue(line, "state", stringPosition)) { // MrBayes or BEAST
-                // keep header from first file
-                if (i == 0) {
-                    thinnedParameters << line << endl;
-                }
-                continue;
-            } else {
-                if ((parameterCounter - burnin) > 0 && (parameterCounter - burnin) < thinning) {
-                    parameterCounter++;
-                    totalParameters++;
-                    continue;
-                } else if ((parameterCounter - burnin) == 0) { // Keep first sample
-                    temp = removeStringElement(line, 0);
-                    thinnedParameters << totalSamples << temp << endl;
-                    parameterCounter++;
-                    totalParameters++;
-                    sampleCounter++;
-                    totalSamples++;
-                    continue;
-                } else if ((parameterCounter - burnin) > 0 && (parameterCounter - burnin) % thinning == 0) {
-                    temp = removeStringElement(line, 0);
-                    thinnedParameters << totalSamples << temp << endl;
-                    parameterCounter++;
-                    totalParameters++;
-                    sampleCounter++;
-                    totalSamples++;
-                    continue;
-                } else {
-                    parameterCounter++;
-                    totalParameters++;
-                    continue;
-                }
-            }
-        }
-        parameterInput.close();
+    // (comments and header only kept from the first file)
+        thinParameterStream(format, parameterInput.stream(), output, (i == 0), numeric, thinning, burnin,
+            parameterCounter, sampleCounter, totalSamples);
+        totalParameters += parameterCounter;
         cout << "Retained " << sampleCounter << " samples." << endl;
     }
+    output.flush();
     thinnedParameters.close();
     
-    cout << endl << "Successfully created file '" << tempFileName << "', populated with "
-        << totalSamples << " samples (from original " << totalParameters << " samples)." << endl;
+    if (toStandardOutput) {
+        cout << endl << "Wrote " << totalSamples << " samples (from original " << totalParameters
+            << " samples) to standard output." << endl;
+    } else {
+        cout << endl << "Successfully created file '" << tempFileName << "', populated with "
+            << totalSamples << " samples (from original " << totalParameters << " samples)." << endl;
+    }
 }
@@ -2,14 +2,23 @@
 #define _TLOG_H_
 
 #include <vector>
+#include <string>
+#include <iostream>
+
+#include "logformat.h"
+#include "translate.h"
 
 using namespace std;
 
+struct BinaryTreeOptions;    // treebinary.h
+struct NumericOutputOptions; // numericlog.h
+
 void printProgramInfo ();
 void printProgramUsage ();
 
 // General functions
 bool checkValidInputFile (string charsetFileName);
+void reportInputFileFailure (string const& fileName);
 bool checkValidOutputFile (string & outputFileName);
 string parseString (string stringToParse, int stringPosition);
 bool checkStringValue (string stringToParse, string stringToMatch, int stringPosition);
@@ -23,14 +32,28 @@ string removeStringElement (string stringToParse, int stringPosition);
 void countTreeSamples (string const& fileName, int const& nruns, string & suffix);
 void countParameterSamples (string const& fileName, int const& nruns, string & suffix);
 vector <string> tokenize (string const& input);
+string runFileName (string const& fileName, int const& nruns, int const& run, string const& suffix);
+string thinnedFileName (string const& fileName, int const& thinning, int const& burnin, int const& nruns,
+    string const& outputSuffix);
+bool retainSample (int const& sampleIndex, int const& burnin, int const& thinning);
+
+// Per-file (stream) workers; dispatch to the dialect-specialised line loops
+int countTreeStream (LogFormat const& format, istream & treeInput);
+int countParameterStream (LogFormat const& format, istream & parameterInput, vector <string> & header);
+int countParameterRows (LogFormat const& format, istream & parameterInput);
+void thinTreeStream (LogFormat const& format, istream & treeInput, ostream & thinnedTrees,
+    bool const& keepHeader, TreeNameMode const& nameMode, int const& thinning, int const& burnin,
+    int & treeCounter, int & sampleCounter, int & totalSamples);
+void thinParameterStream (LogFormat const& format, istream & parameterInput, ostream & thinnedParameters,
+    bool const& keepHeader, NumericOutputOptions const& numeric, int const& thinning, int const& burnin,
+    int & parameterCounter, int & sampleCounter, int & totalSamples);
 
-// Specific user-influenced functions
-void processCommandLineArguments (int argc, char *argv[], string & fileName, int & thinning,
-    int & burnin, string & type, int & nruns, string & suffix, bool & count,
-    bool & overwrite);
+// Specific user-influenced functions (processCommandLineArguments: options.h)
 void collectTreesAndThin (string const& fileName, int const& thinning, int const& burnin,
-    string & suffix, int const& nruns, bool & overwrite);
+    string & suffix, int const& nruns, bool & overwrite, TreeNameMode const& nameMode,
+    BinaryTreeOptions const& binary, string const& outputName);
 void collectParametersAndThin (string const& fileName, int const& thinning, int const& burnin,
-    int const& nruns, string & suffix, bool & overwrite);
+    int const& nruns, string & suffix, bool & overwrite, string const& outputName,
+    NumericOutputOptions const& numeric);
 
 #endif /* _TLOG_H_ */
\ No newline at end of file
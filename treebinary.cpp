@@ -0,0 +1,627 @@
+
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+using namespace std;
+
+#include "translog.h"
+#include "logformat.h"
+#include "logstream.h"
+#include "treebinary.h"
+
+static const char startMagic[] = "TLTRBIN1";
+static const char endMagic[] = "TLTRBEND";
+static const int trailerSize = 16; // footer offset + end magic
+
+// *** Encoding helpers *** //
+
+static void appendVarint (string & out, uint64_t value) {
+    while (value >= 0x80) {
+        out += (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+static bool readVarint (string const& in, size_t & pos, uint64_t & value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+        unsigned char byte = in[pos++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void appendFixed64 (string & out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out += (char)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static uint64_t readFixed64 (const char * in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t)(unsigned char)in[i] << (8 * i);
+    }
+    return value;
+}
+
+static void appendString (string & out, string const& text) {
+    appendVarint(out, text.size());
+    out += text;
+}
+
+static bool readString (string const& in, size_t & pos, string & text) {
+    uint64_t length = 0;
+    if (!readVarint(in, pos, length) || pos + length > in.size()) {
+        return false;
+    }
+    text.assign(in, pos, length);
+    pos += length;
+    return true;
+}
+
+static uint64_t zigzag (int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag (uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// A branch length in quantized mode, as a whole number of 10^-decimals units. Only text that
+// decoding writes back identically is accepted ('0.012346' with 6 decimals; not '1.2346e-02',
+// '.5', '0.5' or '-0.000000'); returns the end of the number, or string::npos.
+static size_t readQuantizedLength (string const& line, size_t pos, int const& decimals, int64_t & units) {
+    size_t len = line.size();
+    bool negative = (pos < len && line[pos] == '-');
+    if (negative) {
+        pos++;
+    }
+    size_t start = pos;
+    while (pos < len && line[pos] >= '0' && line[pos] <= '9') {
+        pos++;
+    }
+    size_t numIntegerDigits = pos - start;
+    if (numIntegerDigits == 0 || (numIntegerDigits > 1 && line[start] == '0')) {
+        return string::npos;
+    }
+    if (decimals > 0) {
+        if (pos >= len || line[pos] != '.') {
+            return string::npos;
+        }
+        pos++;
+        size_t fractionStart = pos;
+        while (pos < len && line[pos] >= '0' && line[pos] <= '9') {
+            pos++;
+        }
+        if (pos - fractionStart != (size_t)decimals) {
+            return string::npos;
+        }
+    }
+    if (numIntegerDigits + decimals > 18) { // beyond int64
+        return string::npos;
+    }
+    units = 0;
+    for (size_t i = start; i < pos; i++) {
+        if (line[i] != '.') {
+            units = units * 10 + (line[i] - '0');
+        }
+    }
+    if (negative && units == 0) {
+        return string::npos;
+    }
+    if (negative) {
+        units = -units;
+    }
+    return pos;
+}
+
+static bool isLabelChar (char c) {
+    return !(c == ':' || c == ',' || c == '(' || c == ')' || c == ';' || c == '[' || c == ']'
+        || c == '\'' || isSpaceChar(c));
+}
+
+BranchLengthEncoding parseBranchLengthEncoding (string const& option, int & decimals) {
+    if (option == "float") {
+        decimals = 0;
+        return LENGTHS_FLOAT;
+    }
+    decimals = convertStringtoInt(option);
+    if (decimals < 0 || decimals > 12 || option.find_first_not_of("0123456789") != string::npos) {
+        cerr << "Error: binary branch lengths must be 'float' or a number of decimal places (0-12). Exiting." << endl;
+        exit(1);
+    }
+    return LENGTHS_QUANTIZED;
+}
+
+// *** TreeBinaryWriter *** //
+
+TreeBinaryWriter::TreeBinaryWriter ()
+    : encoding_(LENGTHS_QUANTIZED), decimals_(6), treesEncountered_(false), position_(0)
+{
+}
+
+bool TreeBinaryWriter::open (string const& fileName, BranchLengthEncoding const& encoding,
+    int const& decimals)
+{
+    encoding_ = encoding;
+    decimals_ = decimals;
+    output_.open(fileName.c_str(), ios::binary);
+    if (output_.fail()) {
+        return false;
+    }
+    output_.write(startMagic, 8);
+    position_ = 8;
+    return true;
+}
+
+// Lines arrive exactly as they would be written to thinned NEXUS output
+void TreeBinaryWriter::addLine (string const& line) {
+    size_t start = skipWhiteSpace(line, 0);
+    size_t end = skipToken(line, start);
+    if (tokenMatches(line, start, end, "tree")) {
+        treesEncountered_ = true;
+        addTree(line);
+    } else if (!treesEncountered_) {
+        header_ += line;
+        header_ += '\n';
+    } else {
+        string & note = notes_[offsets_.size()];
+        note += line;
+        note += '\n';
+    }
+}
+
+void TreeBinaryWriter::addTree (string const& line) {
+    size_t pos = skipToken(line, skipWhiteSpace(line, 0)); // 'tree'
+    pos = skipToken(line, skipWhiteSpace(line, pos));      // 'STATE_n'
+    size_t treeStart = pos;
+    while (treeStart < line.size() && line[treeStart] != '(') {
+        if (line[treeStart] == '[') {
+            treeStart = line.find(']', treeStart);
+            if (treeStart == string::npos) {
+                treeStart = line.size();
+                break;
+            }
+        }
+        treeStart++;
+    }
+
+    record_.clear();
+    if (treeStart < line.size() && encodeTree(line, treeStart)) {
+        appendVarint(record_, 0);
+        appendString(record_, line.substr(pos, treeStart - pos));
+        appendVarint(record_, tokens_.size());
+        for (size_t i = 0; i < tokens_.size(); i++) {
+            appendVarint(record_, tokens_[i]);
+        }
+        for (size_t i = 0; i < lengths_.size(); i++) {
+            float length = (float)lengths_[i];
+            uint32_t bits;
+            memcpy(&bits, &length, 4);
+            for (int b = 0; b < 4; b++) {
+                record_ += (char)((bits >> (8 * b)) & 0xFF);
+            }
+        }
+        for (size_t i = 0; i < units_.size(); i++) {
+            appendVarint(record_, zigzag(units_[i]));
+        }
+    } else {
+        appendVarint(record_, 1);
+        appendString(record_, line.substr(pos));
+    }
+    offsets_.push_back(position_);
+    output_.write(record_.data(), record_.size());
+    position_ += record_.size();
+}
+
+// Tokenises a plain newick tree (taxon labels, parentheses, commas, branch lengths).
+// Returns false for anything else (comments, internal node labels, quoted labels,
+// whitespace, lengths that quantizing would not reproduce), which is then stored as raw text.
+bool TreeBinaryWriter::encodeTree (string const& line, size_t pos) {
+    tokens_.clear();
+    lengths_.clear();
+    units_.clear();
+    int depth = 0;
+    bool nodeComplete = false; // just finished a leaf or ')'
+    bool hasLength = false;
+    size_t len = line.size();
+    string label;
+
+    while (pos < len) {
+        char c = line[pos];
+        if (c == '(') {
+            if (nodeComplete) {
+                return false;
+            }
+            tokens_.push_back(0);
+            depth++;
+            pos++;
+        } else if (c == ')') {
+            if (!nodeComplete || depth == 0) {
+                return false;
+            }
+            tokens_.push_back(1 << 1);
+            depth--;
+            hasLength = false;
+            pos++;
+            if (pos < len && line[pos] != ':' && line[pos] != ',' && line[pos] != ')' && line[pos] != ';') {
+                return false; // internal node label or comment
+            }
+        } else if (c == ',') {
+            if (!nodeComplete || depth == 0) {
+                return false;
+            }
+            nodeComplete = false;
+            pos++;
+        } else if (c == ':') {
+            if (!nodeComplete || hasLength) {
+                return false;
+            }
+            if (encoding_ == LENGTHS_QUANTIZED) {
+                int64_t units;
+                size_t end = readQuantizedLength(line, pos + 1, decimals_, units);
+                if (end == string::npos) {
+                    return false;
+                }
+                units_.push_back(units);
+                pos = end;
+            } else {
+                const char * numberStart = line.c_str() + pos + 1;
+                char * numberEnd = NULL;
+                double length = strtod(numberStart, &numberEnd);
+                if (numberEnd == numberStart || isSpaceChar(*numberStart)) {
+                    return false;
+                }
+                lengths_.push_back(length);
+                pos += 1 + (numberEnd - numberStart);
+            }
+            tokens_.back() |= 1;
+            hasLength = true;
+        } else if (c == ';') {
+            if (depth != 0 || !nodeComplete) {
+                return false;
+            }
+            return skipWhiteSpace(line, pos + 1) == len;
+        } else if (isLabelChar(c)) {
+            if (nodeComplete || depth == 0) {
+                return false;
+            }
+            size_t end = pos;
+            while (end < len && isLabelChar(line[end])) {
+                end++;
+            }
+            label.assign(line, pos, end - pos);
+            map <string, int>::iterator found = taxonIndex_.find(label);
+            int taxon;
+            if (found == taxonIndex_.end()) {
+                taxon = taxa_.size();
+                taxonIndex_[label] = taxon;
+                taxa_.push_back(label);
+            } else {
+                taxon = found->second;
+            }
+            tokens_.push_back((uint64_t)(2 + taxon) << 1);
+            hasLength = false;
+            pos = end;
+        } else {
+            return false;
+        }
+        if (c == ')' || isLabelChar(c)) {
+            nodeComplete = true;
+        }
+    }
+    return false; // no terminating ';'
+}
+
+void TreeBinaryWriter::close () {
+    string footer;
+    appendString(footer, header_);
+    appendVarint(footer, taxa_.size());
+    for (size_t i = 0; i < taxa_.size(); i++) {
+        appendString(footer, taxa_[i]);
+    }
+    footer += (char)encoding_;
+    footer += (char)decimals_;
+    appendVarint(footer, offsets_.size());
+    for (size_t i = 0; i < offsets_.size(); i++) {
+        appendFixed64(footer, offsets_[i]);
+    }
+    if (!notes_.empty()) {
+        appendVarint(footer, notes_.size());
+        for (map <int, string>::const_iterator note = notes_.begin(); note != notes_.end(); note++) {
+            appendVarint(footer, note->first);
+            appendString(footer, note->second);
+        }
+    }
+    appendFixed64(footer, position_);
+    footer.append(endMagic, 8);
+    output_.write(footer.data(), footer.size());
+    output_.close();
+}
+
+// *** TreeBinaryLineBuffer *** //
+
+TreeBinaryLineBuffer::int_type TreeBinaryLineBuffer::overflow (int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    char character = traits_type::to_char_type(c);
+    if (character == '\n') {
+        writer_.addLine(line_);
+        line_.clear();
+    } else {
+        line_ += character;
+    }
+    return c;
+}
+
+streamsize TreeBinaryLineBuffer::xsputn (const char * s, streamsize n) {
+    streamsize start = 0;
+    for (streamsize i = 0; i < n; i++) {
+        if (s[i] == '\n') {
+            line_.append(s + start, i - start);
+            writer_.addLine(line_);
+            line_.clear();
+            start = i + 1;
+        }
+    }
+    line_.append(s + start, n - start);
+    return n;
+}
+
+// *** TreeBinaryReader *** //
+
+bool TreeBinaryReader::open (string const& fileName) {
+    input_.open(fileName.c_str(), ios::binary | ios::ate);
+    if (input_.fail()) {
+        return false;
+    }
+    long long fileSize = input_.tellg();
+    if (fileSize < 8 + trailerSize) {
+        return false;
+    }
+    char magic[8];
+    input_.seekg(0);
+    input_.read(magic, 8);
+    if (memcmp(magic, startMagic, 8) != 0) {
+        return false;
+    }
+    char trailer[trailerSize];
+    input_.seekg(fileSize - trailerSize);
+    input_.read(trailer, trailerSize);
+    if (memcmp(trailer + 8, endMagic, 8) != 0) {
+        return false;
+    }
+    footerStart_ = readFixed64(trailer);
+    if (footerStart_ < 8 || (long long)footerStart_ > fileSize - trailerSize) {
+        return false;
+    }
+
+    string footer(fileSize - trailerSize - footerStart_, '\0');
+    input_.seekg(footerStart_);
+    input_.read(&footer[0], footer.size());
+
+    size_t pos = 0;
+    uint64_t count = 0;
+    if (!readString(footer, pos, header_) || !readVarint(footer, pos, count)) {
+        return false;
+    }
+    taxa_.resize(count);
+    for (uint64_t i = 0; i < count; i++) {
+        if (!readString(footer, pos, taxa_[i])) {
+            return false;
+        }
+    }
+    if (pos + 2 > footer.size()) {
+        return false;
+    }
+    encoding_ = (BranchLengthEncoding)footer[pos++];
+    decimals_ = footer[pos++];
+    if (!readVarint(footer, pos, count) || pos + 8 * count > footer.size()) {
+        return false;
+    }
+// records are never empty: each must start after the one before and before the footer,
+// or readSample would be sized from a wrapped-around difference
+    offsets_.resize(count);
+    for (uint64_t i = 0; i < count; i++) {
+        offsets_[i] = readFixed64(&footer[pos + 8 * i]);
+        if (offsets_[i] < (i == 0 ? 8 : offsets_[i - 1] + 1) || offsets_[i] >= footerStart_) {
+            return false;
+        }
+    }
+    pos += 8 * count;
+    notes_.clear();
+    if (pos < footer.size()) {
+        uint64_t numNotes = 0;
+        if (!readVarint(footer, pos, numNotes)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < numNotes; i++) {
+            uint64_t sample = 0;
+            string text;
+            if (!readVarint(footer, pos, sample) || sample > offsets_.size() || !readString(footer, pos, text)) {
+                return false;
+            }
+            notes_[sample] = text;
+        }
+    }
+    return pos == footer.size();
+}
+
+string const& TreeBinaryReader::linesBefore (int const& sample) const {
+    static const string none;
+    map <int, string>::const_iterator note = notes_.find(sample);
+    return note == notes_.end() ? none : note->second;
+}
+
+static void appendQuantizedLength (string & out, int64_t value, int const& decimals) {
+    if (value < 0) {
+        out += '-';
+        value = -value;
+    }
+    string digits = to_string(value);
+    if (decimals > 0) {
+        if ((int)digits.size() <= decimals) {
+            digits.insert(0, decimals + 1 - digits.size(), '0');
+        }
+        digits.insert(digits.size() - decimals, 1, '.');
+    }
+    out += digits;
+}
+
+bool TreeBinaryReader::readSample (int const& sample, int const& label, string & line) {
+    if (sample < 0 || sample >= (int)offsets_.size()) {
+        return false;
+    }
+    uint64_t start = offsets_[sample];
+    uint64_t end = (sample + 1 < (int)offsets_.size()) ? offsets_[sample + 1] : footerStart_;
+    record_.resize(end - start);
+    input_.clear();
+    input_.seekg(start);
+    input_.read(&record_[0], record_.size());
+
+    line = "tree STATE_" + to_string(label);
+    size_t pos = 0;
+    uint64_t kind = 0;
+    string text;
+    if (!readVarint(record_, pos, kind) || !readString(record_, pos, text)) {
+        return false;
+    }
+    line += text;
+    if (kind == 1) {
+        return true;
+    }
+
+    uint64_t numTokens = 0;
+    if (!readVarint(record_, pos, numTokens)) {
+        return false;
+    }
+    vector <uint64_t> tokens(numTokens);
+    for (uint64_t i = 0; i < numTokens; i++) {
+        if (!readVarint(record_, pos, tokens[i])) {
+            return false;
+        }
+    }
+
+    bool needComma = false;
+    char number[32];
+    for (uint64_t i = 0; i < numTokens; i++) {
+        uint64_t code = tokens[i] >> 1;
+        if (code == 0) {
+            if (needComma) {
+                line += ',';
+            }
+            line += '(';
+            needComma = false;
+        } else if (code == 1) {
+            line += ')';
+            needComma = true;
+        } else {
+            if (code - 2 >= taxa_.size()) {
+                return false;
+            }
+            if (needComma) {
+                line += ',';
+            }
+            line += taxa_[code - 2];
+            needComma = true;
+        }
+        if (tokens[i] & 1) {
+            line += ':';
+            if (encoding_ == LENGTHS_FLOAT) {
+                if (pos + 4 > record_.size()) {
+                    return false;
+                }
+                uint32_t bits = 0;
+                for (int b = 0; b < 4; b++) {
+                    bits |= (uint32_t)(unsigned char)record_[pos + b] << (8 * b);
+                }
+                pos += 4;
+                float length;
+                memcpy(&length, &bits, 4);
+                snprintf(number, sizeof(number), "%.7g", length);
+                line += number;
+            } else {
+                uint64_t value = 0;
+                if (!readVarint(record_, pos, value)) {
+                    return false;
+                }
+                appendQuantizedLength(line, unzigzag(value), decimals_);
+            }
+        }
+    }
+    line += ';';
+    return true;
+}
+
+// *** Conversion back to NEXUS *** //
+
+void convertTreeBinaryToNexus (string const& fileName, int const& thinning, int const& burnin,
+    bool & overwrite, string const& outputName)
+{
+    TreeBinaryReader reader;
+    if (!reader.open(fileName)) {
+        cerr << endl << "Translogrifier analysis failed. " << endl << "Error: '" << fileName
+            << "' is not a readable binary tree file." << endl;
+        exit(1);
+    }
+
+    string outputFileName = outputName;
+    if (outputFileName.empty() && (thinning > 1 || burnin > 0)) {
+        outputFileName = thinnedFileName(fileName, thinning, burnin, 1, "trees");
+    } else if (outputFileName.empty()) {
+        bool suffixEncountered = false;
+        outputFileName = removeStringSuffix(fileName, '.', suffixEncountered) + ".trees";
+    }
+    bool toStandardOutput = isStandardStream(outputFileName);
+    if (!overwrite && !toStandardOutput) {
+        bool validFileName = false;
+        while (!validFileName) {
+            validFileName = checkValidOutputFile(outputFileName);
+        }
+    }
+
+    cout << "CONVERTING " << reader.numSamples() << " BINARY TREE SAMPLES TO NEXUS..." << endl << endl;
+
+    ofstream outputFile;
+    if (!toStandardOutput) {
+        outputFile.open(outputFileName.c_str());
+    }
+    ostream output(toStandardOutput ? standardOutputBuffer() : outputFile.rdbuf());
+    output << reader.header();
+    string line;
+    int totalSamples = 0;
+// as in text thinning, lines between the trees are kept whether or not their neighbours are
+    for (int i = 0; i < reader.numSamples(); i++) {
+        output << reader.linesBefore(i);
+        if (!retainSample(i, burnin, thinning)) {
+            continue;
+        }
+        if (!reader.readSample(i, totalSamples, line)) {
+            cerr << "Error: sample " << i << " of '" << fileName << "' is corrupt. Exiting." << endl;
+            exit(1);
+        }
+        line += '\n';
+        output.write(line.data(), line.size());
+        totalSamples++;
+    }
+    output << reader.linesBefore(reader.numSamples());
+    output << "End;" << endl;
+    output.flush();
+    outputFile.close();
+
+    if (toStandardOutput) {
+        cout << "Wrote " << totalSamples << " trees (from original " << reader.numSamples()
+            << " samples) to standard output." << endl;
+    } else {
+        cout << "Successfully created file '" << outputFileName << "', populated with " << totalSamples
+            << " trees (from original " << reader.numSamples() << " samples)." << endl;
+    }
+}
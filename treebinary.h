@@ -0,0 +1,106 @@
+#ifndef _TREEBINARY_H_
+#define _TREEBINARY_H_
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <streambuf>
+#include <map>
+#include <stdint.h>
+
+using namespace std;
+
+// Compact binary tree-sample file ('.tbin'), written in place of thinned NEXUS text.
+//
+//   "TLTRBIN1"
+//   sample records, one per tree:
+//     varint kind: 0 = encoded, 1 = raw text (anything the encoding cannot represent)
+//     raw:     varint length, tree text following the 'tree STATE_n' label
+//     encoded: varint length, text between label and tree (e.g. "\t=\t[&U]\t")
+//              varint number of tokens, then tokens (varint: token << 1 | has branch length)
+//              where token 0 = '(', 1 = ')', 2 + i = taxon i; then the branch lengths
+//   footer: varint length + NEXUS header text (everything preceding the first tree),
+//           varint number of taxa + each taxon label (as it appears in the trees),
+//           branch length encoding, decimals, varint number of samples,
+//           fixed 8-byte offset of each sample record (random access),
+//           varint number of notes + each note: varint sample, text of the lines (comments,
+//           blank lines) that came before that sample among the trees (sample = number of
+//           samples: after the last); absent in files without any
+//   8-byte offset of the footer, "TLTRBEND"
+
+enum BranchLengthEncoding {
+    LENGTHS_QUANTIZED, // fixed number of decimal places, zigzag varint; exact (other lengths are kept as text)
+    LENGTHS_FLOAT      // IEEE float32; lossy
+};
+
+struct BinaryTreeOptions {
+    bool enabled;
+    BranchLengthEncoding encoding;
+    int decimals;
+};
+
+class TreeBinaryWriter {
+public:
+    TreeBinaryWriter ();
+    bool open (string const& fileName, BranchLengthEncoding const& encoding, int const& decimals);
+    void addLine (string const& line);
+    void close ();
+    int numSamples () const { return offsets_.size(); }
+private:
+    void addTree (string const& line);
+    bool encodeTree (string const& line, size_t pos);
+    ofstream output_;
+    BranchLengthEncoding encoding_;
+    int decimals_;
+    bool treesEncountered_;
+    string header_;
+    map <string, int> taxonIndex_;
+    vector <string> taxa_;
+    vector <uint64_t> offsets_;
+    uint64_t position_;
+    string record_;
+    vector <uint64_t> tokens_;
+    vector <double> lengths_;  // LENGTHS_FLOAT
+    vector <int64_t> units_;   // LENGTHS_QUANTIZED
+    map <int, string> notes_;  // non-tree lines after the first tree, by the sample they precede
+};
+
+// Adapts the thinned text stream (line by line) to a TreeBinaryWriter
+class TreeBinaryLineBuffer : public streambuf {
+public:
+    explicit TreeBinaryLineBuffer (TreeBinaryWriter & writer) : writer_(writer) {}
+protected:
+    int_type overflow (int_type c);
+    streamsize xsputn (const char * s, streamsize n);
+private:
+    TreeBinaryWriter & writer_;
+    string line_;
+};
+
+class TreeBinaryReader {
+public:
+    bool open (string const& fileName);
+    int numSamples () const { return offsets_.size(); }
+    string const& header () const { return header_; }
+    vector <string> const& taxa () const { return taxa_; }
+    // 'tree STATE_<label>' plus the decoded tree, as in thinned NEXUS output
+    bool readSample (int const& sample, int const& label, string & line);
+    // lines (each ending in a newline) between the previous sample and this one
+    string const& linesBefore (int const& sample) const;
+private:
+    ifstream input_;
+    string header_;
+    vector <string> taxa_;
+    BranchLengthEncoding encoding_;
+    int decimals_;
+    vector <uint64_t> offsets_;
+    uint64_t footerStart_;
+    string record_;
+    map <int, string> notes_;
+};
+
+BranchLengthEncoding parseBranchLengthEncoding (string const& option, int & decimals);
+void convertTreeBinaryToNexus (string const& fileName, int const& thinning, int const& burnin,
+    bool & overwrite, string const& outputName);
+
+#endif /* _TREEBINARY_H_ */